@@ -0,0 +1,87 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace std;
+
+/*
+ * A bump allocator for the buffers of one pass (e.g. a tessellation).
+ *
+ * Blocks are carved from large chunks and never freed one by one: all of
+ * them go at once, with the arena or by reset(). A pass that knows its size
+ * up front (see the 'chunkBytes' of the constructor) makes one allocation.
+ * Blocks larger than a chunk get a chunk of their own.
+ *
+ * Not thread-safe: use one arena per thread.
+ */
+class Arena
+{
+public:
+	explicit Arena(size_t chunkBytes = 1 << 20) : chunkBytes(chunkBytes), used(0), total(0) {}
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+	~Arena() { for(Chunk &chunk: chunks) free(chunk.data); }
+
+	void *allocate(size_t bytes, size_t align = alignof(max_align_t))
+	{
+		assert(align > 0 and (align & (align - 1)) == 0);
+		if(not chunks.empty())
+		{
+			const size_t offset {(used + align - 1) & ~(align - 1)};
+			if(offset + bytes <= chunks.back().size)
+			{
+				used = offset + bytes;
+				total += bytes;
+				return chunks.back().data + offset;
+			}
+		}
+		// malloc aligns to max_align_t; larger alignments are padded
+		const size_t size {max(chunkBytes, bytes + (align > alignof(max_align_t) ? align : 0))};
+		char *data {(char *) malloc(size)};
+		if(data == NULL)
+			throw bad_alloc();
+		chunks.push_back({data, size});
+		used = ((size_t(data) + align - 1) & ~(align - 1)) - size_t(data) + bytes;
+		total += bytes;
+		return data + used - bytes;
+	}
+
+	template <class T>
+	T *allocate(int n) { return (T *) allocate(n * sizeof(T), alignof(T)); }
+
+	// Release every block; the last chunk is kept for the next pass
+	void reset()
+	{
+		if(chunks.empty())
+			return;
+		const Chunk last {chunks.back()};
+		chunks.pop_back();
+		for(Chunk &chunk: chunks) free(chunk.data);
+		chunks.assign(1, last);
+		used = 0;
+		total = 0;
+	}
+
+	size_t getBytes() const { return total; } // handed out since the last reset
+	int numChunks() const { return (int)chunks.size(); }
+
+private:
+	struct Chunk
+	{
+		char *data;
+		size_t size;
+	};
+
+	size_t chunkBytes;
+	size_t used; // in the last chunk
+	size_t total;
+	vector<Chunk> chunks;
+};
+
+#endif // ARENA_H
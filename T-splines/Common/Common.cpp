@@ -1,6 +1,10 @@
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include "Common/Common.h"
 
 using namespace std;
@@ -168,4 +172,107 @@ double Util::rand1()
 {
 	const double x = RAND_MAX + 1;
 	return ((rand() / x) + rand()) / x;
-}
\ No newline at end of file
+}
+
+
+int ThreadUtil::numThreads(int n, int minPerThread)
+{
+	const int hw = max<int>(1, thread::hardware_concurrency());
+	return max(1, min(hw, n / max(1, minPerThread)));
+}
+
+/*
+ * Worker threads for parallelFor(), started on first use and kept until the
+ * program exits. A call queues its chunks as a job and takes chunks of it
+ * itself until none are left, then waits for those the workers took: so
+ * calls may come from several threads at once, or from inside a chunk.
+ */
+class WorkerPool
+{
+public:
+	static WorkerPool &get()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	void run(int n, int nchunks, const function<void (int, int)> &f)
+	{
+		Job J {&f, n, nchunks};
+		unique_lock<mutex> guard(lock);
+		jobs.push_back(&J);
+		wake.notify_all();
+		while(J.next < J.nchunks)
+			runChunk(J, guard);
+		finished.wait(guard, [&]() { return J.done == J.nchunks; });
+	}
+
+	~WorkerPool()
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			stop = true;
+		}
+		wake.notify_all();
+		for(auto &w: workers) w.join();
+	}
+
+private:
+	struct Job
+	{
+		const function<void (int, int)> *f;
+		int n, nchunks;
+		int next {0}; // the next chunk to hand out
+		int done {0}; // the chunks finished
+	};
+
+	mutex lock;
+	condition_variable wake, finished;
+	deque<Job*> jobs; // those with chunks left to hand out
+	vector<thread> workers;
+	bool stop {false};
+
+	WorkerPool()
+	{
+		// The calling thread takes chunks too
+		const int hw = max<int>(1, thread::hardware_concurrency());
+		FOR(i,1,hw)
+			workers.emplace_back([this]() { work(); });
+	}
+
+	// Run the next chunk of J (with 'lock' held, released meanwhile)
+	void runChunk(Job &J, unique_lock<mutex> &guard)
+	{
+		const int i {J.next++};
+		if(J.next == J.nchunks)
+			jobs.erase(find(begin(jobs), end(jobs), &J));
+		guard.unlock();
+		(*J.f)(int((long long)J.n * i / J.nchunks), int((long long)J.n * (i + 1) / J.nchunks));
+		guard.lock();
+		if(++J.done == J.nchunks)
+			finished.notify_all();
+	}
+
+	void work()
+	{
+		unique_lock<mutex> guard(lock);
+		while(true)
+		{
+			wake.wait(guard, [&]() { return stop or not jobs.empty(); });
+			if(stop)
+				return;
+			runChunk(*jobs.front(), guard);
+		}
+	}
+};
+
+void ThreadUtil::parallelFor(int n, int minPerThread, const function<void (int, int)> &f)
+{
+	const int nchunks = numThreads(n, minPerThread);
+	if(nchunks <= 1)
+	{
+		if(n > 0) f(0, n);
+		return;
+	}
+	WorkerPool::get().run(n, nchunks, f);
+}
@@ -7,6 +7,7 @@
 #include <FL/gl.h>
 
 #include <algorithm>
+#include <functional>
 #include <map>
 #include <vector>
 #include <sstream>
@@ -70,6 +71,20 @@ namespace Util {
 using namespace Util;
 
 
+namespace ThreadUtil {
+	/*
+	 * Run f(begin, end) over [0, n) split into contiguous chunks, one per
+	 * hardware thread, on a pool of worker threads started on first use
+	 * (and on the calling thread). Runs serially when n is below
+	 * 'minPerThread' * 2. May be called from any thread, also from inside f.
+	 */
+	void parallelFor(int n, int minPerThread, const function<void (int, int)> &f);
+	// The number of threads parallelFor(n, minPerThread, ...) runs on
+	int numThreads(int n, int minPerThread);
+}
+using namespace ThreadUtil;
+
+
 
 // Short-cut macros
 #define FOR(i,a,b) for(int _b=(b),i=(a);i<_b;++i)
@@ -80,6 +95,8 @@ using namespace Util;
 // Shortened type names for convenience
 typedef vector<Pt3> VP3;
 typedef vector<VP3> VVP3;
+typedef vector<Pt3f> VP3f;
+typedef vector<VP3f> VVP3f;
 
 typedef pair<Pt3,Pt3> PT3;
 
@@ -4,26 +4,28 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <cassert>
 #include <iostream>
+#include <array>
+#include <utility>
 
-using namespace std;
-
-#ifndef DELETE_OPS
-#define DELETE_OPS
-#define CLEAN_DELETE(p) if(p) delete p
-#define CLEAN_ARRAY_DELETE(p) if(p) delete [] p
+#ifdef __AVX2__
+#include <immintrin.h>
 #endif
 
+using namespace std;
+
 template <class Type, int N>
 class Matrix
 {
-	template <class Type, int N> class Vector;
-	friend class Vector<Type, N>;
+public:
+	typedef array<Type, N> Row;
+	typedef array<Row, N> Rows;
 
 protected:
-	Type **data;
+	Rows data; // inline: matrices never touch the allocator
 
 	int pivot(int row) {
 		int k = row;
@@ -43,118 +45,93 @@ protected:
 		return k;
 	}
 
-public:
-	Matrix() : data(NULL) {
-		data = new Type*[N];
-		for(int r = 0; r < N; r++)
-			data[r] = new Type[N];
-		identity();
-	}
-
-	Matrix(const Matrix<Type, N> &A) {
-		data = new Type*[N];
-		for(int r = 0; r < N; r++) {
-			data[r] = new Type[N];
-			memcpy(data[r], A.data[r], sizeof(Type) * N);
+	// Element-wise generators: C++14 std::array has no constexpr non-const access,
+	// so constexpr results are built in one aggregate from f(r, c)
+	template <class F, size_t... C>
+	static constexpr Row generateRow(const F &f, int r, index_sequence<C...>) {
+		return Row {{f(r, int(C))...}};
+	}
+	template <class F, size_t... R>
+	static constexpr Matrix generate(const F &f, index_sequence<R...>) {
+		return Matrix(Rows {{generateRow(f, int(R), make_index_sequence<N>())...}});
+	}
+	template <class F>
+	static constexpr Matrix generate(const F &f) { return generate(f, make_index_sequence<N>()); }
+
+	struct Identity {
+		constexpr Type operator() (int r, int c) const { return Type(r == c); }
+	};
+	struct Sum {
+		const Matrix &L, &R;
+		constexpr Type operator() (int r, int c) const { return L.data[r][c] + R.data[r][c]; }
+	};
+	struct Difference {
+		const Matrix &L, &R;
+		constexpr Type operator() (int r, int c) const { return L.data[r][c] - R.data[r][c]; }
+	};
+	struct Product {
+		const Matrix &L, &R;
+		constexpr Type operator() (int r, int c) const {
+			Type s = Type(0);
+			for(int k = 0; k < N; k++)
+				s += L.data[r][k] * R.data[k][c];
+			return s;
 		}
-	}
-	virtual ~Matrix() { clean(); }
+	};
+	struct Scaled {
+		Type alpha;
+		const Matrix &R;
+		constexpr Type operator() (int r, int c) const { return alpha * R.data[r][c]; }
+	};
+	struct Transposed {
+		const Matrix &B;
+		constexpr Type operator() (int r, int c) const { return B.data[c][r]; }
+	};
 
-	Type **Data() { return data; }
+public:
+	constexpr Matrix() : Matrix(generate(Identity {})) {}
+	constexpr explicit Matrix(const Rows &rows) : data(rows) {}
 
-	void clean() {
-		if(data) {
-			for(int r = 0; r < N; r++)
-				CLEAN_ARRAY_DELETE(data[r]);
-			CLEAN_ARRAY_DELETE(data);
-			data = NULL;
-		}
-	}
+	static constexpr Matrix identityMatrix() { return Matrix(); }
 
-	void identity() {
-		for(int i = 0; i < N; i++)
-			for(int j = 0; j < N; j++)
-				data[i][j] = Type(i == j);
-	}
-	void clear() {
-		for(int i = 0; i < N; i++)
-			for(int j = 0; j < N; j++)
-				data[i][j] = Type(0);
-	}
-	int size() const { return N; }
+	Type *Data() { return data[0].data(); } // N * N row-major values
 
-	void operator= (const Matrix<Type, N> &A) {
-		if(data == NULL) {
-			data = new Type*[N];
-			for(int r = 0; r < N; r++)
-				data[r] = new Type[N];
-		}
-		for(int r = 0; r < N; r++)
-			memcpy(data[r], A.data[r], sizeof(Type) * N);
+	void identity() { *this = identityMatrix(); }
+	void clear() {
+		for(Row &row : data)
+			row.fill(Type(0));
 	}
+	constexpr int size() const { return N; }
 
-	inline Type*& operator[] (int r) {
-		assert(r >= 0 && r < N);
-		return data[r];
-	}
-	inline Type *operator[] (int r) const {
+	inline Row& operator[] (int r) {
 		assert(r >= 0 && r < N);
 		return data[r];
 	}
+	inline constexpr const Row& operator[] (int r) const { return data[r]; }
 
 
 	/************************* FRIEND FUNCTIONS FOR MATRICES *****************************/
-	friend Matrix<Type, N> operator+ (const Matrix<Type, N> &L, const Matrix<Type, N> &R) {
-		Matrix<Type, N> A;
-		for(int r = 0; r < N; r++)
-			for(int c = 0; c < N; c++)
-				A.data[r][c] = L.data[r][c] + R.data[r][c];
-		return move(A);
+	friend constexpr Matrix<Type, N> operator+ (const Matrix<Type, N> &L, const Matrix<Type, N> &R) {
+		return generate(Sum {L, R});
 	}
 
-	friend Matrix<Type, N> operator* (const Matrix<Type, N> &L, const Matrix<Type, N> &R) {
-		Matrix<Type, N> A;
-		for(int r = 0; r < N; r++) {
-			for(int c = 0; c < N; c++) {
-				A.data[r][c] = Type(0);
-				for(int k = 0; k < N; k++)
-					A.data[r][c] += L.data[r][k] * R.data[k][c];
-			}
-		}
-		return move(A);
+	friend constexpr Matrix<Type, N> operator* (const Matrix<Type, N> &L, const Matrix<Type, N> &R) {
+		return generate(Product {L, R});
 	}
 
-	friend Matrix<Type, N> operator* (const Matrix<Type, N> &L, Type alpha) { return move(alpha * L); }
-	friend Matrix<Type, N> operator* (Type alpha, const Matrix<Type, N> &R) {
-		Matrix<Type, N> A;
-		for(int r = 0; r < N; r++)
-			for(int c = 0; c < N; c++)
-				A.data[r][c] = alpha * R.data[r][c];
-		return move(A);
+	friend constexpr Matrix<Type, N> operator* (const Matrix<Type, N> &L, Type alpha) { return alpha * L; }
+	friend constexpr Matrix<Type, N> operator* (Type alpha, const Matrix<Type, N> &R) {
+		return generate(Scaled {alpha, R});
 	}
 
-	friend Matrix<Type, N> operator- (const Matrix<Type, N> &B) {
-		Matrix<Type, N> A;
-		for(int r = 0; r < N; r++)
-			for(int c = 0; c < N; c++)
-				A.data[r][c] = -B.data[r][c];
-		return move(A);
-	}
+	friend constexpr Matrix<Type, N> operator- (const Matrix<Type, N> &B) { return Type(-1) * B; }
 
-	friend Matrix<Type, N> operator- (const Matrix<Type, N> &L, const Matrix<Type, N> &R) {
-		Matrix<Type, N> A;
-		for(int r = 0; r < N; r++)
-			for(int c = 0; c < N; c++)
-				A.data[r][c] = L.data[r][c] - R.data[r][c];
-		return move(A);
+	friend constexpr Matrix<Type, N> operator- (const Matrix<Type, N> &L, const Matrix<Type, N> &R) {
+		return generate(Difference {L, R});
 	}
 
-	friend Matrix<Type, N> transpose(const Matrix<Type, N> &B) {
-		Matrix<Type, N> A;
-		for(int r = 0; r < N; r++)
-			for(int c = 0; c < N; c++)
-				A.data[c][r] = B.data[r][c];
-		return move(A);
+	friend constexpr Matrix<Type, N> transpose(const Matrix<Type, N> &B) {
+		return generate(Transposed {B});
 	}
 
 	friend Matrix<Type, N> operator! (const Matrix<Type, N> &B) {
@@ -184,14 +161,258 @@ public:
 			}
 		}
 
-		return move(AI);
+		return AI;
+	}
+};
+
+template <class Type, int N> class Vector;
+
+/*
+ * Expression templates for Vector arithmetic.
+ *
+ * Sums, differences, negations and scalings of vectors build a lightweight
+ * expression instead of a Vector per operator; it is evaluated in one fused
+ * pass when assigned to (or converted into) a Vector, e.g.
+ *   layer[j].point = layer[j].point * wa + layer[j+1].point * wb;
+ * reads both points once and writes the result without temporaries.
+ * Expressions keep references to their Vector operands, so they must be
+ * evaluated within the statement (don't hold them in an 'auto' variable).
+ * Every node is element-wise, so assigning to an operand is safe.
+ */
+template <class E, class Type, int N>
+struct VectorExpr
+{
+	typedef Type Scalar;
+	const E &self() const { return static_cast<const E&>(*this); }
+};
+
+/*
+ * Packed registers for the vectors that fill one when AVX2 is enabled:
+ * Vector<double, 4> (__m256d) and Vector<float, 4> (__m128). Loads and
+ * stores are unaligned, since vectors also live in plain new[] and
+ * std::vector storage, which C++14 does not over-align.
+ */
+template <class Type, int N> struct VectorPacket;
+#ifdef __AVX2__
+template <>
+struct VectorPacket<double, 4>
+{
+	typedef __m256d type;
+	static type load(const double *p) { return _mm256_loadu_pd(p); }
+	static void store(double *p, type v) { _mm256_storeu_pd(p, v); }
+	static type add(type a, type b) { return _mm256_add_pd(a, b); }
+	static type sub(type a, type b) { return _mm256_sub_pd(a, b); }
+	static type scale(double alpha, type a) { return _mm256_mul_pd(_mm256_set1_pd(alpha), a); }
+	static type negate(type a) { return _mm256_xor_pd(a, _mm256_set1_pd(-0.0)); }
+	static double dot(type a, type b) {
+		const __m256d m = _mm256_mul_pd(a, b);
+		const __m128d s = _mm_add_pd(_mm256_castpd256_pd128(m), _mm256_extractf128_pd(m, 1));
+		return _mm_cvtsd_f64(_mm_add_sd(s, _mm_unpackhi_pd(s, s)));
+	}
+};
+template <>
+struct VectorPacket<float, 4>
+{
+	typedef __m128 type;
+	static type load(const float *p) { return _mm_loadu_ps(p); }
+	static void store(float *p, type v) { _mm_storeu_ps(p, v); }
+	static type add(type a, type b) { return _mm_add_ps(a, b); }
+	static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+	static type scale(float alpha, type a) { return _mm_mul_ps(_mm_set1_ps(alpha), a); }
+	static type negate(type a) { return _mm_xor_ps(a, _mm_set1_ps(-0.0f)); }
+	static float dot(type a, type b) {
+		const __m128 m = _mm_mul_ps(a, b);
+		const __m128 s = _mm_add_ps(m, _mm_movehl_ps(m, m));
+		return _mm_cvtss_f32(_mm_add_ss(s, _mm_shuffle_ps(s, s, 1)));
 	}
 };
+#endif
 
+// How an expression holds an operand: Vectors by reference, expressions by value
+template <class E>
+struct VectorOperand { typedef const E type; };
 template <class Type, int N>
-class Vector
+struct VectorOperand<Vector<Type, N>> { typedef const Vector<Type, N> &type; };
+
+template <class L, class R, class Type, int N>
+struct VectorSum : VectorExpr<VectorSum<L, R, Type, N>, Type, N>
+{
+	typename VectorOperand<L>::type l;
+	typename VectorOperand<R>::type r;
+	VectorSum(const L &l, const R &r) : l(l), r(r) {}
+	Type operator[] (int i) const { return l[i] + r[i]; }
+#ifdef __AVX2__
+	auto packed() const { return VectorPacket<Type, N>::add(l.packed(), r.packed()); }
+#endif
+};
+
+template <class L, class R, class Type, int N>
+struct VectorDifference : VectorExpr<VectorDifference<L, R, Type, N>, Type, N>
+{
+	typename VectorOperand<L>::type l;
+	typename VectorOperand<R>::type r;
+	VectorDifference(const L &l, const R &r) : l(l), r(r) {}
+	Type operator[] (int i) const { return l[i] - r[i]; }
+#ifdef __AVX2__
+	auto packed() const { return VectorPacket<Type, N>::sub(l.packed(), r.packed()); }
+#endif
+};
+
+template <class E, class Type, int N>
+struct VectorScaled : VectorExpr<VectorScaled<E, Type, N>, Type, N>
+{
+	Type alpha;
+	typename VectorOperand<E>::type e;
+	VectorScaled(Type alpha, const E &e) : alpha(alpha), e(e) {}
+	Type operator[] (int i) const { return alpha * e[i]; }
+#ifdef __AVX2__
+	auto packed() const { return VectorPacket<Type, N>::scale(alpha, e.packed()); }
+#endif
+};
+
+template <class E, class Type, int N>
+struct VectorNegated : VectorExpr<VectorNegated<E, Type, N>, Type, N>
+{
+	typename VectorOperand<E>::type e;
+	explicit VectorNegated(const E &e) : e(e) {}
+	Type operator[] (int i) const { return -e[i]; }
+#ifdef __AVX2__
+	auto packed() const { return VectorPacket<Type, N>::negate(e.packed()); }
+#endif
+};
+
+template <class L, class R, class Type, int N>
+inline VectorSum<L, R, Type, N> operator+ (const VectorExpr<L, Type, N> &U, const VectorExpr<R, Type, N> &V) {
+	return VectorSum<L, R, Type, N>(U.self(), V.self());
+}
+template <class L, class R, class Type, int N>
+inline VectorDifference<L, R, Type, N> operator- (const VectorExpr<L, Type, N> &U, const VectorExpr<R, Type, N> &V) {
+	return VectorDifference<L, R, Type, N>(U.self(), V.self());
+}
+template <class E, class Type, int N>
+inline VectorNegated<E, Type, N> operator- (const VectorExpr<E, Type, N> &U) {
+	return VectorNegated<E, Type, N>(U.self());
+}
+// The scalar is not deduced, so e.g. an int still scales a double vector
+template <class E, class Type, int N>
+inline VectorScaled<E, Type, N> operator* (typename VectorExpr<E, Type, N>::Scalar alpha, const VectorExpr<E, Type, N> &U) {
+	return VectorScaled<E, Type, N>(alpha, U.self());
+}
+template <class E, class Type, int N>
+inline VectorScaled<E, Type, N> operator* (const VectorExpr<E, Type, N> &U, typename VectorExpr<E, Type, N>::Scalar alpha) {
+	return VectorScaled<E, Type, N>(alpha, U.self());
+}
+
+/*
+ * Arithmetic kernels of Vector<Type, N>.
+ *
+ * The loops are the portable version. With AVX2 enabled, vectors that fill
+ * a packed register evaluate expressions and dot products packed, and
+ * Vector<double, 4> (points, normals, colors) also gets packed cross
+ * products and transforms. Sums keep the order of the loops except in the
+ * dot product.
+ *
+ * The Debug and Release configurations do not enable AVX2: these kernels
+ * are inlined everywhere, so the whole program would then require an AVX2
+ * processor, with no way to fall back at run time. The Release-AVX2
+ * configuration (/arch:AVX2, also for Tests) builds them, for such machines
+ * and for comparing the two.
+ */
+template <class Type, int N>
+struct VectorLoops
+{
+	// Evaluate an expression into W
+	template <class E>
+	static void assign(Type *W, const E &e) {
+		for(int i = 0; i < N; i++) W[i] = e[i];
+	}
+	template <class L, class R>
+	static Type dot(const L &U, const R &V) {
+		Type res = 0;
+		for(int i = 0; i < N; i++) res += U[i] * V[i];
+		return res;
+	}
+	static void cross(Type *W, const Type *U, const Type *V) {
+		W[0] = U[1] * V[2] - U[2] * V[1];
+		W[1] = U[2] * V[0] - U[0] * V[2];
+		W[2] = U[0] * V[1] - U[1] * V[0];
+		if(N == 4) W[3] = 0;
+	}
+	// row_vec_U * mat_A
+	static void rowTimesMatrix(Type *W, const Type *U, const Matrix<Type, N> &A) {
+		for(int c = 0; c < N; c++) {
+			W[c] = 0;
+			for(int r = 0; r < N; r++)
+				W[c] += U[r] * A[r][c];
+		}
+	}
+	// mat_A * col_vec_U
+	static void matrixTimesCol(Type *W, const Matrix<Type, N> &A, const Type *U) {
+		for(int r = 0; r < N; r++) {
+			W[r] = 0;
+			for(int c = 0; c < N; c++)
+				W[r] += U[c] * A[r][c];
+		}
+	}
+};
+
+template <class Type, int N>
+struct VectorOps : VectorLoops<Type, N> {};
+
+#ifdef __AVX2__
+template <class Type>
+struct VectorPackedOps : VectorLoops<Type, 4>
+{
+	typedef VectorPacket<Type, 4> P;
+	template <class E>
+	static void assign(Type *W, const E &e) { P::store(W, e.packed()); }
+	template <class L, class R>
+	static Type dot(const L &U, const R &V) { return P::dot(U.packed(), V.packed()); }
+};
+
+template <>
+struct VectorOps<float, 4> : VectorPackedOps<float> {};
+
+template <>
+struct VectorOps<double, 4> : VectorPackedOps<double>
+{
+	static void cross(double *W, const double *U, const double *V) {
+		// U.yzx * V.zxy - U.zxy * V.yzx, with w cleared
+		const __m256d u = _mm256_loadu_pd(U), v = _mm256_loadu_pd(V);
+		const __m256d u1 = _mm256_permute4x64_pd(u, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m256d v2 = _mm256_permute4x64_pd(v, _MM_SHUFFLE(3, 1, 0, 2));
+		const __m256d u2 = _mm256_permute4x64_pd(u, _MM_SHUFFLE(3, 1, 0, 2));
+		const __m256d v1 = _mm256_permute4x64_pd(v, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m256d w = _mm256_sub_pd(_mm256_mul_pd(u1, v2), _mm256_mul_pd(u2, v1));
+		_mm256_storeu_pd(W, _mm256_blend_pd(w, _mm256_setzero_pd(), 8));
+	}
+	static void rowTimesMatrix(double *W, const double *U, const Matrix<double, 4> &A) {
+		// Sum of the rows of A weighted by U
+		__m256d w = _mm256_mul_pd(_mm256_set1_pd(U[0]), _mm256_loadu_pd(A[0].data()));
+		for(int r = 1; r < 4; r++)
+			w = _mm256_add_pd(w, _mm256_mul_pd(_mm256_set1_pd(U[r]), _mm256_loadu_pd(A[r].data())));
+		_mm256_storeu_pd(W, w);
+	}
+	static void matrixTimesCol(double *W, const Matrix<double, 4> &A, const double *U) {
+		// Transpose A in registers, then sum its columns weighted by U
+		const __m256d r0 = _mm256_loadu_pd(A[0].data()), r1 = _mm256_loadu_pd(A[1].data());
+		const __m256d r2 = _mm256_loadu_pd(A[2].data()), r3 = _mm256_loadu_pd(A[3].data());
+		const __m256d t0 = _mm256_unpacklo_pd(r0, r1), t1 = _mm256_unpackhi_pd(r0, r1);
+		const __m256d t2 = _mm256_unpacklo_pd(r2, r3), t3 = _mm256_unpackhi_pd(r2, r3);
+		__m256d w = _mm256_mul_pd(_mm256_set1_pd(U[0]), _mm256_permute2f128_pd(t0, t2, 0x20));
+		w = _mm256_add_pd(w, _mm256_mul_pd(_mm256_set1_pd(U[1]), _mm256_permute2f128_pd(t1, t3, 0x20)));
+		w = _mm256_add_pd(w, _mm256_mul_pd(_mm256_set1_pd(U[2]), _mm256_permute2f128_pd(t0, t2, 0x31)));
+		w = _mm256_add_pd(w, _mm256_mul_pd(_mm256_set1_pd(U[3]), _mm256_permute2f128_pd(t1, t3, 0x31)));
+		_mm256_storeu_pd(W, w);
+	}
+};
+#endif
+
+template <class Type, int N>
+class Vector : public VectorExpr<Vector<Type, N>, Type, N>
 {
 	friend class Matrix<Type, N>;
+	typedef VectorOps<Type, N> Ops;
 
 protected:
 	Type data[N];
@@ -218,28 +439,31 @@ public:
 		data[0] = a; data[1] = b; data[2] = c; data[3] = d;
 	}
 
-	Vector(const Vector<Type, N> &vec) { *this = vec; }
-	~Vector() {}
-
-	void operator+= (const Vector<Type, N> &vec) {
+	// Convert from another precision (e.g. double points to float output)
+	template <class Other>
+	explicit Vector(const Vector<Other, N> &vec) {
 		for(int i = 0; i < N; i++)
-			data[i] += vec.data[i];
+			data[i] = Type(vec[i]);
 	}
-	void operator-= (const Vector<Type, N> &vec) {
-		for(int i = 0; i < N; i++)
-			data[i] -= vec.data[i];
-	}
-	void operator*= (Type alpha) {
-		for(int i = 0; i < N; i++)
-			data[i] *= alpha;
+
+	// Evaluate an expression of vectors
+	template <class E>
+	Vector(const VectorExpr<E, Type, N> &e) { Ops::assign(data, e.self()); }
+	template <class E>
+	Vector<Type, N> &operator= (const VectorExpr<E, Type, N> &e) {
+		Ops::assign(data, e.self());
+		return *this;
 	}
+
+	template <class E>
+	void operator+= (const VectorExpr<E, Type, N> &e) { Ops::assign(data, *this + e.self()); }
+	template <class E>
+	void operator-= (const VectorExpr<E, Type, N> &e) { Ops::assign(data, *this - e.self()); }
+	void operator*= (Type alpha) { Ops::assign(data, alpha * *this); }
 	void operator/= (Type alpha) {
 		for(int i = 0; i < N; i++)
 			data[i] /= alpha;
 	}
-	void operator= (const Vector<Type, N> &vec) {
-		memcpy(data, vec.data, sizeof(Type) * N);
-	}
 
 	void print() const { cout << *this; }
 	friend ostream& operator<< (ostream &out, const Vector<Type, N> U) {
@@ -265,60 +489,22 @@ public:
 	inline Type& operator[] (int i) { return data[i]; }
 	inline Type operator[] (int i) const { return data[i]; }
 
-	friend Vector<Type, N> operator+ (const Vector<Type, N> &U, const Vector<Type, N> &V) {
-		Vector<Type, N> W;
-		for(int i = 0; i < N; i++)
-			W.data[i] = U.data[i] + V.data[i];
-		return move(W);
-	}
-	friend Vector<Type, N> operator- (const Vector<Type, N> &U, const Vector<Type, N> &V) {
-		Vector<Type, N> W;
-		for(int i = 0; i < N; i++)
-			W.data[i] = U.data[i] - V.data[i];
-		return move(W);
-	}
-	friend Vector<Type, N> operator- (const Vector<Type, N> &U) {
-		Vector<Type, N> V;
-		for(int i = 0; i < N; i++)
-			V.data[i] = -U.data[i];
-		return move(V);
-	}
-
-	friend Vector<Type, N> operator* (const Vector<Type, N> &U, Type alpha) { return move(alpha * U); }
-	friend Vector<Type, N> operator* (Type alpha, const Vector<Type, N> &U) {
-		Vector<Type, N> V;
-		for(int i = 0; i < N; i++)
-			V.data[i] = alpha * U.data[i];
-		return move(V);
-	}
+#ifdef __AVX2__
+	auto packed() const { return VectorPacket<Type, N>::load(data); }
+#endif
 
 	// row_vec_U * mat_A => row_vec_UA
 	friend Vector<Type, N> operator* (const Vector<Type, N> &U, const Matrix<Type, N> &A) {
 		Vector<Type, N> UA;
-		for(int c = 0; c < N; c++) {
-			UA.data[c] = 0;
-			for(int r = 0; r < N; r++)
-				UA.data[c] += U.data[r] * A[r][c];
-		}
-		return move(UA);
+		Ops::rowTimesMatrix(UA.data, U.data, A);
+		return UA;
 	}
 
 	// mat_A * col_vec_U => col_vec_AU
 	friend Vector<Type, N> operator* (const Matrix<Type, N> &A, const Vector<Type, N> &U) {
 		Vector<Type, N> AU;
-		for(int r = 0; r < N; r++) {
-			AU.data[r] = 0;
-			for(int c = 0; c < N; c++)
-				AU.data[r] += U.data[c] * A[r][c];
-		}
-		return move(AU);
-	}
-
-	// Dot product between two vectors U, V
-	friend Type operator* (const Vector<Type, N> &U, const Vector<Type, N> &V) {
-		Type res = 0;
-		for(int i = 0; i < N; i++) res += U.data[i] * V.data[i];
-		return res;
+		Ops::matrixTimesCol(AU.data, A, U.data);
+		return AU;
 	}
 
 	inline friend Type mag(const Vector<Type, N> &U) { return sqrt(U*U); }
@@ -328,17 +514,26 @@ public:
 	friend Vector<Type, N> cross(const Vector<Type, N> &U, const Vector<Type, N> &V) {
 		assert(N >= 3 && N <= 4);
 		Vector<Type, N> res;
-		res.data[0] = U.data[1] * V.data[2] - U.data[2] * V.data[1];
-		res.data[1] = U.data[2] * V.data[0] - U.data[0] * V.data[2];
-		res.data[2] = U.data[0] * V.data[1] - U.data[1] * V.data[0];
-		if(N == 4) res.data[3] = 0;
-		return move(res);
+		Ops::cross(res.data, U.data, V.data);
+		return res;
 	}
 };
 
+// Dot product between two vectors U, V
+template <class L, class R, class Type, int N>
+inline Type operator* (const VectorExpr<L, Type, N> &U, const VectorExpr<R, Type, N> &V) {
+	return VectorOps<Type, N>::dot(U.self(), V.self());
+}
+
 typedef Vector<double, 4> Pt3;
 typedef Pt3 Vec3;
 typedef Vector<double, 4> Color;
 typedef Matrix<double, 4> Mat4;
 
+// Single precision points for compact output (e.g. float32 tessellation)
+typedef Vector<float, 4> Pt3f;
+typedef Pt3f Vec3f;
+
+static_assert(sizeof(Mat4) == 16 * sizeof(double), "Mat4 must be stored inline");
+
 #endif // Matrix_h
\ No newline at end of file
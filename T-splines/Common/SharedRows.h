@@ -0,0 +1,121 @@
+#ifndef SHARED_ROWS_H
+#define SHARED_ROWS_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+/*
+ * A 2D array whose rows are shared between copies (copy-on-write).
+ *
+ * Copying only copies the row pointers, so a snapshot of an n x m array costs
+ * O(n). Non-const access to a row the array does not own copies that row
+ * first, so later writes never show through in other copies.
+ *
+ * Ownership is explicit: every array has a generation, renewed whenever it
+ * is copied (from or into), and each row remembers the generation of the
+ * array that made it. Only rows stamped with the array's current generation
+ * are written in place; reference counts are never consulted, so when and on
+ * which thread the other copies are released does not matter.
+ *
+ * Copies may be read (and copied) from other threads, but a given array must
+ * only be written from one thread at a time.
+ */
+template <class T>
+class SharedRows
+{
+public:
+	typedef vector<T> Row;
+
+	SharedRows() : gen(newGeneration()) {}
+	SharedRows(const SharedRows &other)
+		: rows(other.rows), owners(other.rows.size(), 0), gen(newGeneration())
+	{
+		other.gen = newGeneration(); // its rows are shared from now on
+	}
+	SharedRows(SharedRows &&other)
+		: rows(move(other.rows)), owners(move(other.owners)), gen(other.gen.load())
+	{
+		other.clear();
+	}
+	SharedRows &operator=(const SharedRows &other)
+	{
+		if(this != &other)
+		{
+			rows = other.rows;
+			owners.assign(rows.size(), 0);
+			other.gen = newGeneration();
+		}
+		return *this;
+	}
+	SharedRows &operator=(SharedRows &&other)
+	{
+		if(this != &other)
+		{
+			rows = move(other.rows);
+			owners = move(other.owners);
+			gen = other.gen.load();
+			other.clear();
+		}
+		return *this;
+	}
+
+	int size() const { return (int)rows.size(); }
+	bool empty() const { return rows.empty(); }
+
+	// n rows, all equal to 'row' (they share one buffer until written)
+	void assign(int n, const Row &row)
+	{
+		rows.assign(n, make_shared<Row>(row));
+		owners.assign(n, 0);
+	}
+	void resize(int n, const Row &row = Row())
+	{
+		rows.resize(n, make_shared<Row>(row));
+		owners.resize(n, 0);
+	}
+
+	const Row &operator[](int i) const { return *rows[i]; }
+	Row &operator[](int i)
+	{
+		if(owners[i] != gen) // possibly shared: copy before writing
+		{
+			rows[i] = make_shared<Row>(*rows[i]);
+			owners[i] = gen;
+		}
+		return *rows[i];
+	}
+
+	// Replace row i (owned from now on)
+	void setRow(int i, Row row)
+	{
+		rows[i] = make_shared<Row>(move(row));
+		owners[i] = gen;
+	}
+
+	// Whether row i is the very same buffer in both arrays (unchanged in between)
+	bool sharesRow(const SharedRows &other, int i) const { return rows[i] == other.rows[i]; }
+
+private:
+	vector<shared_ptr<Row>> rows;
+	vector<uint64_t> owners; // generation that made each row (0: none)
+	mutable atomic<uint64_t> gen; // renewed by every copy, even from a const array
+
+	static uint64_t newGeneration()
+	{
+		static atomic<uint64_t> next {1};
+		return next++;
+	}
+
+	void clear()
+	{
+		rows.clear();
+		owners.clear();
+		gen = newGeneration();
+	}
+};
+
+#endif // SHARED_ROWS_H
@@ -47,6 +47,10 @@ bool GeometryWindow::_drawGrid = true;
 bool GeometryWindow::_drawControlPoints = true;
 bool GeometryWindow::_drawSurface = true;
 
+unsigned GeometryWindow::_drawnCamera = 0;
+unsigned GeometryWindow::_drawnScene = 0;
+unsigned GeometryWindow::_drawnControlPoints = 0;
+
 mutex GeometryWindow::sceneLock;
 TMeshScene GeometryWindow::_meshScene;
 TriMeshScene GeometryWindow::_scene;
@@ -62,44 +66,110 @@ void GeometryWindow::updateModelView()
 	SceneInfo::updateModelView();
 }
 
-void GeometryWindow::setupControlPoints(TMesh *tmesh)
+void GeometryWindow::setupControlPoints(TMesh *tmesh, const TMesh *previous)
 {
 	sceneLock.lock();
 
+	const int rows {_meshScene.rows}, cols {_meshScene.cols};
 	tmesh->lock.lock();
-	_meshScene.setup(tmesh);
+	_meshScene.setup(tmesh, previous);
 	tmesh->lock.unlock();
 
-	_geom2op.clear();
-	for(const auto &row: _meshScene.gridSpheres)
-		for(const auto &pso: row)
-			_geom2op[pso.first] = pso.second;
+	// The spheres are only replaced when the dimensions change
+	if(_geom2op.empty() or _meshScene.rows != rows or _meshScene.cols != cols)
+	{
+		_geom2op.clear();
+		for(const auto &row: _meshScene.gridSpheres)
+			for(const auto &pso: row)
+				_geom2op[pso.first] = pso.second;
+	}
 
 	_zbuffer.setScene(&_meshScene);
 	_zbuffer.initScene();
 
 	sceneLock.unlock();
+	refresh();
 }
 
 void GeometryWindow::setupSurface(TMesh *tmesh)
 {
-	static TMesh *lastT = NULL;
-	if(tmesh != NULL) // update to the new non-null mesh object
-		lastT = tmesh;
+	if(tmesh != NULL and tmesh != _surfaceMesh) // update to the new non-null mesh object
+	{
+		_surfaceMesh = tmesh;
+		_surfaceBuilt = false;
+	}
+	if(_surfaceMesh == NULL)
+		return;
+	// Nothing is shown: rebuild when the surface is turned back on
+	if(not _drawSurface)
+	{
+		_surfacePending = true;
+		return;
+	}
+	_surfacePending = false;
+
+	// The worker builds from the published snapshot; no need to lock the mesh
+	TMeshSnapshot snapshot {_surfaceMesh->snapshot()};
+	// Skip the rebuild if the mesh did not change since the last one
+	if(_surfaceBuilt and _surfaceGen == snapshot->generation())
+		return;
+	_surfaceGen = snapshot->generation();
+	_surfaceBuilt = true;
+
+	// Undo/redo may return to a surface shown before
+	for(auto it = _recentSurfaces.begin(); it != _recentSurfaces.end(); ++it)
+	{
+		if((*it)->source == snapshot)
+		{
+			unique_ptr<SceneBuffer> buf {move(*it)};
+			_recentSurfaces.erase(it);
+			_rebuilder.cancel();
+			showSurface(move(buf));
+			return;
+		}
+	}
 
 	sceneLock.lock();
+	const SceneBuildSettings settings {_scene.getBuildSettings()};
+	sceneLock.unlock();
 
-	lastT->lock.lock();
-	_scene.setScene(lastT);
-	lastT->lock.unlock();
+	_rebuilder.request(move(snapshot), settings);
+	startPolling();
+}
 
-	_renderer.setTriMeshScene(&_scene);
+void GeometryWindow::takeSurface()
+{
+	unique_ptr<SceneBuffer> buf {_rebuilder.poll()};
+	if(buf)
+		showSurface(move(buf));
+}
+
+void GeometryWindow::showSurface(unique_ptr<SceneBuffer> buf)
+{
+	TMeshSnapshot source {buf->source};
 
+	sceneLock.lock();
+	_scene.swapBuffer(*buf);
+	_renderer.setTriMeshScene(&_scene);
 	sceneLock.unlock();
+	refresh();
+
+	if(buf->isCurve or buf->viewUpdate)
+		return; // curves are cheap to rebuild, and view updates to redo
+	// 'buf' now holds the previous surface: keep it for undo/redo
+	buf->source = move(_shownSource);
+	_shownSource = move(source);
+	if(buf->source and buf->mesh)
+	{
+		_recentSurfaces.push_front(move(buf));
+		if(SZ(_recentSurfaces) > MAX_RECENT_SURFACES)
+			_recentSurfaces.pop_back();
+	}
 }
 
 GeometryWindow::GeometryWindow(int x, int y, int w, int h, const char* l)
-	: Fl_Gl_Window(x, y, w, h+WIN_LOWER_SPACE, l)
+	: Fl_Gl_Window(x, y, w, h+WIN_LOWER_SPACE, l), _surfaceMesh(NULL),
+	  _surfaceGen(0), _surfaceBuilt(false), _surfacePending(false), _polling(false), _history(NULL)
 {
 	show();
 	resize(x, y, w, h);
@@ -119,7 +189,6 @@ GeometryWindow::GeometryWindow(int x, int y, int w, int h, const char* l)
 	_intersector = new Intersector();
 
 	this->callback(escapeButtonCb,this);
-	Fl::repeat_timeout(REFRESH_RATE, GeometryWindow::updateCb, this);
 
 	GeometryWindow::init();
 	_singleton = this;
@@ -178,11 +247,23 @@ void GeometryWindow::draw()
 	_zbuffer.turnOnControlPoints(_drawControlPoints);
 	_zbuffer.draw();
 
+	_scene.setView(m, _proj, _w, _h);
 	if(_drawSurface)
+	{
+		// Refine or coarsen the surface for this view (view-dependent mode only),
+		// in the background: the current one is drawn until the new one is done
+		unique_ptr<SceneBuffer> buf {new SceneBuffer};
+		if(_scene.updateView(*buf) and _rebuilder.requestView(move(buf), _scene.getBuildSettings()))
+			startPolling();
 		_renderer.draw();
+	}
 
 	// Drawing ends here ------------------------------
 
+	_drawnCamera = SceneInfo::getCameraGen();
+	_drawnScene = _scene.getVersion();
+	_drawnControlPoints = _meshScene.getVersion();
+
 	sceneLock.unlock();
 
 	glMatrixMode(GL_PROJECTION);
@@ -202,6 +283,8 @@ int GeometryWindow::handle(int ev)
 	{
 		int x = Fl::event_x();
 		int y = Fl::event_y();
+		Geometry *prevHighlighted = _highlighted;
+		int prevOperatorMode = _zbuffer.getOperatorMode();
 
 		if(_inputMode == INPUT_VIEWING)
 		{
@@ -231,6 +314,12 @@ int GeometryWindow::handle(int ev)
 		else if(_inputMode == INPUT_TRANS) {
 			if(_holdAxis >= 0) {
 				handleAxisTrans(x, y, false);
+				if(ev == FL_DRAG) // the surface follows (rebuilt in the background)
+				{
+					Sphere *sphere = dynamic_cast<Sphere *>(_zbuffer.getOperator()->getPrimaryOp());
+					_meshScene.updateSphere(sphere);
+					setupSurface(NULL);
+				}
 			}
 			if(ev == FL_RELEASE) {
 				Operator* op = _zbuffer.getOperator();
@@ -241,6 +330,8 @@ int GeometryWindow::handle(int ev)
 				Sphere *sphere = dynamic_cast<Sphere *>(op->getPrimaryOp());
 				_meshScene.updateSphere(sphere);
 				setupSurface(NULL);
+				if(_history and _surfaceMesh)
+					_history->record(*_surfaceMesh);
 			}
 		}
 		else if(_inputMode == INPUT_EDITING) {
@@ -360,6 +451,12 @@ int GeometryWindow::handle(int ev)
 		_zbuffer.setHighlighted(_highlighted);
 		_prevMx = x;
 		_prevMy = y;
+
+		// Camera and sphere moves are versioned; the highlight, selection and
+		// operator are not
+		if(ev == FL_PUSH or ev == FL_RELEASE or _highlighted != prevHighlighted
+				or _zbuffer.getOperatorMode() != prevOperatorMode or needsRedraw())
+			redraw();
 	}
 	else if(ev == FL_KEYUP || ev == FL_KEYDOWN)
 	{
@@ -485,8 +582,41 @@ int GeometryWindow::handle(int ev)
 			else if(key == 'c')
 			{
 				_drawSurface ^= 1;
+				if(_drawSurface and _surfacePending)
+					setupSurface(NULL);
+			}
+			// toggle adaptive (t) or view-dependent (l) tessellation, or
+			// single precision output (p); [ and ] halve or double the tolerances
+			else if(key == 't' || key == 'l' || key == 'p' || key == '[' || key == ']')
+			{
+				sceneLock.lock();
+				TessellationOptions opt {_scene.getTessellation()};
+				if(key == 't')
+					opt.adaptive ^= 1;
+				else if(key == 'l')
+					opt.screenSpace ^= 1;
+				else if(key == 'p')
+					opt.singlePrecision ^= 1;
+				else
+				{
+					const double f {(key == '[') ? 0.5 : 2.0};
+					opt.chordTol *= f;
+					opt.pixelTol *= f;
+					opt.normalTol = min(90.0, opt.normalTol * f);
+				}
+				_scene.setTessellation(opt, false);
+				sceneLock.unlock();
+				// Surfaces kept for undo/redo have the old tessellation
+				_recentSurfaces.clear();
+				_shownSource = NULL;
+				// Re-tessellate in the background
+				_surfaceBuilt = false;
+				setupSurface(NULL);
 			}
 		}
+
+		// Keys toggle display options (and Ctrl the highlight)
+		redraw();
 	}
 
 	// TODO: which one to use?
@@ -503,6 +633,7 @@ void GeometryWindow::resize(int x0, int y0, int w, int h) {
 
 	if(_arcBall)
 		_arcBall->setBounds((float)w, (float)h);
+	updateModelView(); // the viewport is part of the camera
 }
 
 // handles the camera rotation (arcball)
@@ -624,6 +755,7 @@ void GeometryWindow::handleAxisTrans(int mx, int my, bool beginTrans) {
 			case OP_YAXIS: op->translate(Vec3(0, cpt[1]-_prevMPt[1], 0, 0)); break;
 			case OP_ZAXIS: op->translate(Vec3(0, 0, cpt[2]-_prevMPt[2], 0)); break;
 		}
+		_meshScene.sphereMoved(); // its links follow
 	}
 	_prevMPt = cpt;
 }
\ No newline at end of file
@@ -18,10 +18,23 @@
 #include "Rendering/ZBufferRenderer.h"
 
 #include "TMesh.h"
+#include "SceneRebuilder.h"
+#include "TMeshHistory.h"
+
+#include <deque>
 
 class GeometryWindow : public Fl_Gl_Window {
 protected:
 	Fl_Button* _triButton;
+	TMesh *_surfaceMesh; // the mesh of the last surface update
+	unsigned _surfaceGen; // generation of '_surfaceMesh' the last rebuild was requested for
+	bool _surfaceBuilt; // whether '_surfaceGen' is meaningful
+	bool _surfacePending; // an update was skipped while the surface was hidden
+	SceneRebuilder _rebuilder; // builds surfaces off the UI thread
+	bool _polling; // whether pollCb() is scheduled
+	TMeshSnapshot _shownSource; // mesh state of the surface in '_scene'
+	deque<unique_ptr<SceneBuffer>> _recentSurfaces; // surfaces shown before, newest first
+	TMeshHistory *_history; // where control point moves are recorded
 
 	static int _w, _h;
 	static int _frames;
@@ -59,6 +72,9 @@ protected:
 	static bool _drawSurface;
 	static GeometryWindow *_singleton;
 
+	// Camera generation and scene versions shown by the last draw()
+	static unsigned _drawnCamera, _drawnScene, _drawnControlPoints;
+
 	static mutex sceneLock;
 
 	static TMeshScene _meshScene;
@@ -73,8 +89,17 @@ public:
 
 	static TMeshScene* getScene() { return &_singleton->_meshScene; }
 
-	void setupControlPoints(TMesh *tmesh);
+	// Only the control points that differ from 'previous' are moved, if given
+	void setupControlPoints(TMesh *tmesh, const TMesh *previous = NULL);
 	void setupSurface(TMesh *tmesh);
+	// Show the curve/surface the rebuild worker finished, if any
+	void takeSurface();
+	void setHistory(TMeshHistory *history) { _history = history; }
+	// Redraw if the camera or either scene changed since the last draw()
+	static void refresh() {
+		if(_singleton and needsRedraw())
+			_singleton->redraw();
+	}
 
 	void draw();
 	int handle(int flag);
@@ -95,13 +120,32 @@ protected:
 
 	static void exitButtonCb(Fl_Widget* widget, void* win) { exit(0); }
 	static void escapeButtonCb(Fl_Widget* widget, void* win) {}
-	static void updateCb(void* userdata) {
+	// Whether the camera or either scene changed since the last draw()
+	static bool needsRedraw() {
+		return SceneInfo::getCameraGen() != _drawnCamera or _scene.getVersion() != _drawnScene
+			or _meshScene.getVersion() != _drawnControlPoints;
+	}
+	// Poll the rebuild worker while it has work (pending, running or not yet taken)
+	void startPolling() {
+		if(not _polling)
+			Fl::add_timeout(REFRESH_RATE, GeometryWindow::pollCb, this);
+		_polling = true;
+	}
+	static void pollCb(void* userdata) {
 		GeometryWindow* viewer = (GeometryWindow*) userdata;
-		viewer->redraw();
-		Fl::repeat_timeout(REFRESH_RATE, GeometryWindow::updateCb, userdata);
+		viewer->takeSurface();
+		viewer->_polling = viewer->_rebuilder.busy();
+		if(viewer->_polling)
+			Fl::repeat_timeout(REFRESH_RATE, GeometryWindow::pollCb, userdata);
 	}
 
 	void resize(int x, int y, int w, int h);
+
+private:
+	// Surfaces kept for undo/redo
+	static const int MAX_RECENT_SURFACES = 8;
+
+	void showSurface(unique_ptr<SceneBuffer> buf);
 };
 
 #endif
\ No newline at end of file
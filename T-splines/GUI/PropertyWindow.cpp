@@ -1,4 +1,5 @@
 #include "GUI/PropertyWindow.h"
+#include "GUI/GeometryWindow.h"
 #include <FL/Fl_Color_Chooser.h>
 #include <FL/Fl_Menu_Bar.H>
 #include "Common/Common.h"
@@ -94,6 +95,8 @@ void PropertyWindow::closePropertyWindow() {
 void PropertyWindow::handleAllCb(Fl_Widget* widget, void* w) {
 	PropertyWindow* win = (PropertyWindow*) w;
 	win->getGeometry()->accept(win->getGeometryUpdater(), NULL);
+	GeometryWindow::getScene()->sphereMoved();
+	GeometryWindow::refresh();
 }
 
 void PropertyWindow::escapeButtonCb(Fl_Widget* widget, void* win) {
@@ -10,6 +10,7 @@ using namespace std;
 const int WIN_LOWER_SPACE = 30;
 
 TMesh TopologyWindow::_mesh(7, 7, 3, 3);
+TMeshHistory TopologyWindow::_history;
 
 TopologyWindow::TopologyWindow(int x, int y, int w, int h, const char* l)
 	: Fl_Window(x,y,w,h+WIN_LOWER_SPACE,l)
@@ -36,6 +37,20 @@ TopologyWindow::TopologyWindow(int x, int y, int w, int h, const char* l)
 		}
 		fileGroup->end();
 
+		editGroup = new Fl_Group(470, 20, 150, 40, "Edit");
+		editGroup->color(WIN_COLOR);
+		editGroup->box(FL_BORDER_BOX);
+		editGroup->begin();
+		{
+			undoButton = new Button(480, 30, 60, 20, "Undo");
+			undoButton->shortcut(FL_CTRL + 'z');
+			undoButton->callback(undoButtonCallback, this);
+			redoButton = new Button(550, 30, 60, 20, "Redo");
+			redoButton->shortcut(FL_CTRL + 'y');
+			redoButton->callback(redoButtonCallback, this);
+		}
+		editGroup->end();
+
 		knotsHInput = new Fl_Input(370, 70, 200, 20, "H knots: ");
 		knotsHButton = new Button(580, 70, 60, 20, "Update");
 		knotsHButton->callback(knotsHButtonCallback, this);
@@ -57,8 +72,10 @@ TopologyWindow::TopologyWindow(int x, int y, int w, int h, const char* l)
 
 	//loadMesh("files/default.txt");
 	updatePanel();
+	_history.reset(_mesh);
 
-	Fl::repeat_timeout(REFRESH_RATE, TopologyWindow::updateTopologyStatus, this);
+	_statusGen = _mesh.topologyGen - 1; // label now
+	updateTopologyStatus();
 }
 
 TopologyWindow::~TopologyWindow()
@@ -68,6 +85,9 @@ TopologyWindow::~TopologyWindow()
 	delete loadButton;
 	delete saveButton;
 	delete fileGroup;
+	delete undoButton;
+	delete redoButton;
+	delete editGroup;
 
 	delete topStatLabel;
 	delete knotsHInput;
@@ -136,7 +156,10 @@ void TopologyWindow::loadMesh(char *filePath)
 		if(not TMesh::checkDuplicateAtKnotEnds(_mesh.knotsV, _mesh.rows, _mesh.degV))
 			printf("* Warning: Vertical knot values are not repeated at end points\n");
 
+		_history.reset(_mesh);
 		updatePanel();
+		updateTopologyStatus();
+		_viewer->refresh();
 		updateControlPoints();
 		updateSurface();
 	}
@@ -156,6 +179,64 @@ void TopologyWindow::saveMesh()
 		printf("Saved [%s] successfully\n", filePath);
 }
 
+void TopologyWindow::recordEdit()
+{
+	_history.record(_mesh);
+}
+
+void TopologyWindow::beginEdit()
+{
+	_editBefore = _mesh.snapshot();
+	_mesh.beginEdit();
+}
+
+void TopologyWindow::commitEdit()
+{
+	const int changes {_mesh.commitEdit()};
+	const TMeshSnapshot before {move(_editBefore)};
+	if(changes == EDIT_NONE)
+		return;
+
+	recordEdit();
+	refreshViews(before, changes);
+}
+
+void TopologyWindow::undo()
+{
+	const TMeshSnapshot before {_mesh.snapshot()};
+	_mesh.lock.lock();
+	const bool done {_history.undo(_mesh)};
+	_mesh.lock.unlock();
+	if(done)
+		refreshViews(before, EDIT_ALL);
+}
+
+void TopologyWindow::redo()
+{
+	const TMeshSnapshot before {_mesh.snapshot()};
+	_mesh.lock.lock();
+	const bool done {_history.redo(_mesh)};
+	_mesh.lock.unlock();
+	if(done)
+		refreshViews(before, EDIT_ALL);
+}
+
+void TopologyWindow::refreshViews(const TMeshSnapshot &before, int changes)
+{
+	if(changes & EDIT_KNOTS)
+		updatePanel();
+	updateTopologyStatus();
+	_viewer->refresh();
+	if(_geometry)
+	{
+		// Knots don't move control points; otherwise only the changed rows are updated
+		if(changes & (EDIT_TOPOLOGY | EDIT_GEOMETRY))
+			_geometry->setupControlPoints(&_mesh, before.get());
+		if(_mesh.isAS) // the surface is not defined otherwise
+			_geometry->setupSurface(&_mesh);
+	}
+}
+
 void TopologyWindow::loadButtonCallback(Fl_Widget* widget, void* userdata)
 {
 	TopologyWindow *topology = (TopologyWindow*)userdata;
@@ -170,6 +251,20 @@ void TopologyWindow::saveButtonCallback(Fl_Widget* widget, void* userdata)
 		topology->saveMesh();
 }
 
+void TopologyWindow::undoButtonCallback(Fl_Widget* widget, void* userdata)
+{
+	TopologyWindow *topology = (TopologyWindow*)userdata;
+	if(topology)
+		topology->undo();
+}
+
+void TopologyWindow::redoButtonCallback(Fl_Widget* widget, void* userdata)
+{
+	TopologyWindow *topology = (TopologyWindow*)userdata;
+	if(topology)
+		topology->redo();
+}
+
 void TopologyWindow::knotsHButtonCallback(Fl_Widget* widget, void* userdata)
 {
 	TopologyWindow *topology = (TopologyWindow*)userdata;
@@ -193,13 +288,10 @@ void TopologyWindow::knotsHButtonCallback(Fl_Widget* widget, void* userdata)
 		if(not TMesh::checkDuplicateAtKnotEnds(knotsH, cols, degH))
 			printf("\n* Warning: Horizontal knot values are not repeated at end points\n");
 
-		_mesh.lock.lock();
+		topology->beginEdit();
 		assert(SZ(_mesh.knotsH) == SZ(knotsH));
-		_mesh.knotsH = move(knotsH);
-		_mesh.lock.unlock();
-
-		topology->updateControlPoints();
-		topology->updateSurface();
+		_mesh.setKnots(false, move(knotsH));
+		topology->commitEdit();
 
 		printf("\nUpdated horizontal knots\n");
 	}
@@ -228,33 +320,34 @@ void TopologyWindow::knotsVButtonCallback(Fl_Widget* widget, void* userdata)
 		if(not TMesh::checkDuplicateAtKnotEnds(knotsV, rows, degV))
 			printf("\n* Warning: Vertical knot values are not repeated at end points\n");
 
-		_mesh.lock.lock();
+		topology->beginEdit();
 		assert(SZ(_mesh.knotsV) == SZ(knotsV));
-		_mesh.knotsV = move(knotsV);
-		_mesh.lock.unlock();
-
-		topology->updateControlPoints();
-		topology->updateSurface();
+		_mesh.setKnots(true, move(knotsV));
+		topology->commitEdit();
 
 		printf("\nUpdated vertical knots\n");
 	}
 }
 
-void TopologyWindow::updateTopologyStatus(void* userdata)
+void TopologyWindow::updateTopologyStatus()
 {
-	TopologyWindow *tw = (TopologyWindow *)userdata;
-	if(not tw or not tw->topStatLabel) return;
-
-	if(not tw->_mesh.validVertices)
-		tw->topStatLabel->label("Invalid Vertices");
-	else if(not tw->_mesh.isAD)
-		tw->topStatLabel->label("T-Mesh is not Admissible (AD)");
-	else if(not tw->_mesh.isAS)
-		tw->topStatLabel->label("T-Mesh is not Analysis-Suitable (AS)");
-	else if(not tw->_mesh.isDS)
-		tw->topStatLabel->label("T-Mesh is not de Boor-Suitable (DS)");
-	else
-		tw->topStatLabel->label("T-Mesh OK");
+	if(not topStatLabel) return;
 
-	Fl::repeat_timeout(REFRESH_RATE, TopologyWindow::updateTopologyStatus, userdata);
+	// The status only depends on the topology
+	if(_statusGen == _mesh.topologyGen)
+		return;
+	_statusGen = _mesh.topologyGen;
+
+	if(not _mesh.validVertices)
+		topStatLabel->label("Invalid Vertices");
+	else if(not _mesh.isAD)
+		topStatLabel->label("T-Mesh is not Admissible (AD)");
+	else if(not _mesh.isAS and not _mesh.isCubic())
+		topStatLabel->label("T-junctions need degrees (3,3)");
+	else if(not _mesh.isAS)
+		topStatLabel->label("T-Mesh is not Analysis-Suitable (AS)");
+	else if(not _mesh.isDS)
+		topStatLabel->label("T-Mesh is not de Boor-Suitable (DS)");
+	else
+		topStatLabel->label("T-Mesh OK");
 }
\ No newline at end of file
@@ -15,11 +15,14 @@
 #include "Common/Common.h"
 #include "GUI/GeometryWindow.h"
 #include "Rendering/TopologyViewer.h"
+#include "TMeshHistory.h"
 
 class TopologyWindow : public Fl_Window
 {
 protected:
 	static TMesh _mesh;
+	static TMeshHistory _history;
+	TMeshSnapshot _editBefore; // the state before the open edit transaction
 
 	TopologyViewer *_viewer;
 	GeometryWindow *_geometry;
@@ -27,12 +30,16 @@ protected:
 	Fl_Group *fileGroup;
 	Button *loadButton;
 	Button *saveButton;
+	Fl_Group *editGroup;
+	Button *undoButton;
+	Button *redoButton;
 
 	Fl_Box *topStatLabel;
 	Fl_Input *knotsHInput;
 	Fl_Input *knotsVInput;
 	Button *knotsHButton;
 	Button *knotsVButton;
+	unsigned _statusGen; // topology generation shown in 'topStatLabel'
 
 public:
 	TopologyWindow(int x, int y, int w, int h, const char* l);
@@ -42,9 +49,20 @@ public:
 	void updateSurface();
 	void loadMesh(char *filePath = NULL);
 	void saveMesh();
+	/*
+	 * Edit transaction on the mesh (see TMesh::beginEdit()): the history,
+	 * the panel and the geometry window are updated once, at commit.
+	 */
+	void beginEdit();
+	void commitEdit();
+	// Add the current state of the mesh to the undo history (after an edit)
+	void recordEdit();
+	void undo();
+	void redo();
 	void setup(GeometryWindow *geometry)
 	{
 		_geometry = geometry;
+		_geometry->setHistory(&_history);
 		updateControlPoints();
 		updateSurface();
 	}
@@ -52,12 +70,19 @@ public:
 protected:
 	static void loadButtonCallback(Fl_Widget* widget, void* userdata);
 	static void saveButtonCallback(Fl_Widget* widget, void* userdata);
+	static void undoButtonCallback(Fl_Widget* widget, void* userdata);
+	static void redoButtonCallback(Fl_Widget* widget, void* userdata);
 	static void knotsHButtonCallback(Fl_Widget* widget, void* userdata);
 	static void knotsVButtonCallback(Fl_Widget* widget, void* userdata);
-	static void updateTopologyStatus(void* userdata);
 
 	static void exitButtonCb(Fl_Widget* widget, void* win) { exit(0); }
 	static void escapeButtonCb(Fl_Widget* widget, void* win) {}
+
+private:
+	// Show the changes (EditBits) since the state 'before'
+	void refreshViews(const TMeshSnapshot &before, int changes);
+	// Label the validity of the topology, if it changed since last time
+	void updateTopologyStatus();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,197 @@
+#include "Rendering/MeshOptimizer.h"
+
+// Score of a vertex by its cache position (-1 if not cached) and its number of triangles left
+static float vertexScore(int cachePos, int live)
+{
+	static const int MAX_LIVE = 32;
+	struct Table
+	{
+		float score[MeshOptimizer::CACHE_SIZE + 1][MAX_LIVE + 1];
+		Table()
+		{
+			FOR(p,-1,MeshOptimizer::CACHE_SIZE) FOR(l,1,MAX_LIVE+1)
+			{
+				// The last triangle's vertices score the same, so that no order is preferred among them
+				float s {0};
+				if(0 <= p and p < 3)
+					s = 0.75f;
+				else if(p >= 3)
+					s = pow(1 - float(p - 3) / (MeshOptimizer::CACHE_SIZE - 3), 1.5f);
+				// Favor vertices with few triangles left, to finish them off
+				score[p + 1][l] = s + 2 * pow(float(l), -0.5f);
+			}
+		}
+	};
+	static const Table table;
+	if(live == 0)
+		return -1;
+	return table.score[cachePos + 1][min(live, MAX_LIVE)];
+}
+
+void MeshOptimizer::optimizeVertexCache(TriInd* tris, int ntris, int nverts)
+{
+	// Vertex -> triangle adjacency; the live triangles of v are adj[first[v] .. first[v] + live[v])
+	vector<int> first(nverts + 1, 0), live(nverts, 0), adj(3 * ntris);
+	FOR(j,0,ntris) FOR(k,0,3)
+		live[tris[j][k]]++;
+	FOR(v,0,nverts)
+		first[v + 1] = first[v] + live[v];
+	vector<int> fill(first.begin(), first.end() - 1);
+	FOR(j,0,ntris) FOR(k,0,3)
+		adj[fill[tris[j][k]]++] = j;
+
+	vector<int> cachePos(nverts, -1);
+	vector<float> vscore(nverts);
+	vector<bool> added(ntris, false);
+	FOR(v,0,nverts)
+		vscore[v] = vertexScore(-1, live[v]);
+	auto triScore = [&](int j) { return vscore[tris[j][0]] + vscore[tris[j][1]] + vscore[tris[j][2]]; };
+
+	int best {-1};
+	float bestScore {-1};
+	FOR(j,0,ntris)
+	{
+		const float score {triScore(j)};
+		if(score > bestScore)
+		{
+			best = j;
+			bestScore = score;
+		}
+	}
+
+	vector<TriInd> order;
+	order.reserve(ntris);
+	// The cached vertices, and while updating them the next ones: at most the
+	// CACHE_SIZE cached ones and the triangle's 3
+	array<int, CACHE_SIZE + 3> cache, next;
+	int cacheLen {0};
+	int scan {0}; // no triangle before it is left, for when the cache has none
+	while(best >= 0)
+	{
+		const TriInd tri {tris[best]};
+		added[best] = true;
+		order.push_back(tri);
+
+		FOR(k,0,3)
+		{
+			const int v {tri[k]};
+			int *A {&adj[first[v]]};
+			FOR(i,0,live[v]) if(A[i] == best)
+			{
+				swap(A[i], A[--live[v]]);
+				break;
+			}
+		}
+
+		// The triangle's vertices go first, pushing the others back (and out past CACHE_SIZE)
+		int nextLen {0};
+		FOR(k,0,3)
+			if(find(next.data(), next.data() + nextLen, tri[k]) == next.data() + nextLen)
+				next[nextLen++] = tri[k];
+		int *triEnd {next.data() + nextLen};
+		FOR(i,0,cacheLen)
+			if(find(next.data(), triEnd, cache[i]) == triEnd)
+				next[nextLen++] = cache[i];
+		FOR(i,0,nextLen)
+		{
+			const int v {next[i]};
+			cachePos[v] = i < CACHE_SIZE ? i : -1;
+			vscore[v] = vertexScore(cachePos[v], live[v]);
+		}
+		assert(nextLen <= SZ(next));
+		cacheLen = min(nextLen, int(CACHE_SIZE));
+		copy_n(next.begin(), cacheLen, cache.begin());
+
+		// The next triangle is the best scored one of the cached vertices
+		best = -1;
+		bestScore = -1;
+		FOR(i,0,cacheLen)
+		{
+			const int v {next[i]};
+			FOR(a,first[v],first[v]+live[v])
+			{
+				const int j {adj[a]};
+				const float score {triScore(j)};
+				if(score > bestScore)
+				{
+					best = j;
+					bestScore = score;
+				}
+			}
+		}
+		if(best < 0)
+		{
+			while(scan < ntris and added[scan])
+				scan++;
+			best = scan < ntris ? scan : -1;
+		}
+	}
+
+	copy(order.begin(), order.end(), tris);
+}
+
+void MeshOptimizer::optimizeVertexFetch(TriInd* tris, int ntris, int nverts, vector<int>& order)
+{
+	vector<int> index(nverts, -1);
+	order.clear();
+	order.reserve(nverts);
+	FOR(j,0,ntris) FOR(k,0,3)
+	{
+		int &v = tris[j][k];
+		if(index[v] < 0)
+		{
+			index[v] = SZ(order);
+			order.push_back(v);
+		}
+		v = index[v];
+	}
+	FOR(v,0,nverts) if(index[v] < 0)
+		order.push_back(v);
+}
+
+void MeshOptimizer::makeStrips(const TriInd* tris, int ntris, unsigned restart, vector<unsigned>& strip)
+{
+	strip.clear();
+
+	/*
+	 * Triangle i of a strip s is (s[i], s[i+1], s[i+2]) if i is even and
+	 * (s[i+1], s[i], s[i+2]) if odd: the next one continues the strip if it
+	 * has the directed edge (s[i+1], s[i+2]), resp. (s[i+2], s[i+1]).
+	 * Returns the third vertex then, or -1.
+	 */
+	auto continues = [](const TriInd &tri, int from, int to)
+	{
+		FOR(k,0,3) if(tri[k] == from and tri[(k + 1) % 3] == to)
+			return tri[(k + 2) % 3];
+		return -1;
+	};
+
+	int j {0};
+	while(j < ntris)
+	{
+		if(not strip.empty())
+			strip.push_back(restart);
+
+		// Start with the rotation of the triangle that the next one continues
+		const TriInd &tri {tris[j]};
+		int rot {0};
+		if(j + 1 < ntris)
+			FOR(r,0,3) if(continues(tris[j + 1], tri[(r + 2) % 3], tri[(r + 1) % 3]) >= 0)
+			{
+				rot = r;
+				break;
+			}
+		FOR(k,0,3)
+			strip.push_back(tri[(rot + k) % 3]);
+		j++;
+
+		for(int count {1}; j < ntris; count++, j++)
+		{
+			const int p {int(strip[strip.size() - 2])}, q {int(strip.back())};
+			const int r {count % 2 == 0 ? continues(tris[j], p, q) : continues(tris[j], q, p)};
+			if(r < 0)
+				break;
+			strip.push_back(r);
+		}
+	}
+}
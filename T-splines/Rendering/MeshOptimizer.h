@@ -0,0 +1,41 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include "Rendering/RenderingPrimitives.h"
+
+/*
+ * Orderings of indexed triangle meshes for faster vertex processing.
+ *
+ * The GPU keeps recently transformed vertices in a small cache, so a vertex
+ * shared by consecutive triangles is transformed once. Reordering the
+ * triangles keeps the working set within that cache (modeled as
+ * CACHE_SIZE entries); renumbering the vertices in the order they are
+ * first used then makes their fetches sequential.
+ */
+class MeshOptimizer
+{
+public:
+	static const int CACHE_SIZE = 16; // smaller than most GPU caches, so that orderings hold on all of them
+
+	/*
+	 * Reorder the triangles for the vertex cache, greedily taking the best
+	 * scored triangle among those of the cached vertices (Tom Forsyth's
+	 * "Linear-speed vertex cache optimisation"). Runs in O(ntris * CACHE_SIZE).
+	 */
+	static void optimizeVertexCache(TriInd* tris, int ntris, int nverts);
+
+	/*
+	 * Renumber the vertices in order of first use by the triangles (unused
+	 * ones last). order[i] receives the former index of vertex i.
+	 */
+	static void optimizeVertexFetch(TriInd* tris, int ntris, int nverts, vector<int>& order);
+
+	/*
+	 * The triangles as strips, in their order and orientation, separated by
+	 * 'restart' (a primitive restart index). A triangle continues the strip
+	 * when it shares the strip's last edge.
+	 */
+	static void makeStrips(const TriInd* tris, int ntris, unsigned restart, vector<unsigned>& strip);
+};
+
+#endif // MESH_OPTIMIZER_H
@@ -22,66 +22,24 @@ void MeshRenderer::draw()
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 		glDisable(GL_CULL_FACE);
 
+		updateBuffer();
+
 		// Draw the interpolated curve
 		if(_scene->willDrawCurve())
 		{
-			vector<pair<Pt3, int>> &P = _scene->getCurve();
 			glShadeModel(GL_FLAT);
 			glColor4d(1,1,1,1);
 			glDisable(GL_LIGHTING);
 			glDisable(GL_COLOR_MATERIAL);
 
-			for(int j = 0; j < 2; ++j)
-			{
-				if(j == 0) // First draw lines
-				{
-					glLineWidth(2);
-					glBegin(GL_LINE_STRIP);
-				}
-				else // Then draw points
-				{
-					glPointSize(2);
-					glBegin(GL_POINTS);
-				}
-
-				for(int i = 0; i < (int) P.size(); ++i)
-				{
-					int a = P[i].second % 3;
-					glColor3d(a == 0, a == 1, a == 2);
-					glVertex3dv(&P[i].first[0]);
-				}
-				glEnd();
-			}
+			// First draw lines, then points
+			glLineWidth(2);
+			_buffer.draw(GL_LINE_STRIP, false, true);
+			glPointSize(2);
+			_buffer.draw(GL_POINTS, false, true);
 		}
 		else // Draw the interpolated surface
 		{
-			const TriMesh* m = _scene->getMesh();
-			Pt3Array* pts = m->getPoints();
-			const TriIndArray* inds = m->getInds();
-			Vec3Array* vnorms = m->getVNormals();
-			Vec3Array* fnorms = m->getFNormals();
-
-			auto normColor = [&](const Pt3 &norm)
-			{
-				double color[3];
-
-				// Scheme 1
-				/*
-				double sum = 0;
-				FOR(i,0,3)
-				{
-					double a = abs(norm[i]);
-					sum += color[i] = a;
-				}
-				FOR(i,0,3) color[i] /= sum;
-				//*/
-
-				// Scheme 2
-				FOR(i,0,3) color[i] = ((norm[i] + 1) * 0.5) * (0.5 * abs(norm[i]) + 0.5);
-
-				glColor3dv(color);
-			};
-
 			// Use normals, no lighting
 			if(useNormal)
 			{
@@ -95,50 +53,8 @@ void MeshRenderer::draw()
 				glColor3d(1, 1, 1);
 			}
 
-			if(getShadingModel() == SHADE_GOURAUD)
-			{
-				glShadeModel(GL_SMOOTH);
-				glBegin(GL_TRIANGLES);
-				FOR(j,0,inds->size())
-				{
-					const TriInd& ti = inds->get(j);
-					const Vec3 &fn = fnorms->get(j);
-					FOR(k,0,3)
-					{
-						const Vec3 vn = vnorms->get(ti[k]);
-						/*
-						 * Don't use the vertex normal if it's too different
-						 * from the face normal.
-						 */
-						const double threshold = 0.7;
-						Vec3 norm = ((vn * fn) > threshold) ? vn : fn;
-						if(useNormal)
-							normColor(norm);
-						else
-							glNormal3dv(&norm[0]);
-
-						glVertex3dv(&pts->get(ti[k])[0]);
-					}
-				}
-				glEnd();
-			}
-			else
-			{
-				glShadeModel(GL_FLAT);
-				glBegin(GL_TRIANGLES);
-				FOR(j,0,inds->size())
-				{
-					Vec3 fn = fnorms->get(j);
-					if(useNormal)
-						normColor(fn);
-					else
-						glNormal3dv(&fn[0]);
-
-					const TriInd& ti = inds->get(j);
-					FOR(k,0,3) glVertex3dv(&pts->get(ti[k])[0]);
-				}
-				glEnd();
-			}
+			glShadeModel(getShadingModel() == SHADE_GOURAUD ? GL_SMOOTH : GL_FLAT);
+			_buffer.draw(GL_TRIANGLES, not useNormal, useNormal);
 
 			// Wireframes
 			if(drawWire)
@@ -150,16 +66,122 @@ void MeshRenderer::draw()
 
 				glLineWidth(1);
 				glColor3d(0.1, 0.1, 0.1);
-				glBegin(GL_TRIANGLES);
-				FOR(j,0,inds->size())
+				_buffer.draw(GL_TRIANGLES, false, false);
+			}
+		}
+	}
+}
+
+void MeshRenderer::updateBuffer()
+{
+	const bool curve {_scene->willDrawCurve()};
+	if(_builtScene == _scene and _builtVersion == _scene->getVersion() and
+		(curve or _builtShading == getShadingModel()))
+		return;
+
+	_builtScene = _scene;
+	_builtVersion = _scene->getVersion();
+	_builtShading = getShadingModel();
+
+	vector<VertexBuffer::Vertex> V;
+	vector<unsigned> I; // none: V in order
+	auto addVertex = [&](const auto &p, const auto &n, const double color[3])
+	{
+		VertexBuffer::Vertex v;
+		FOR(k,0,3)
+		{
+			v.pos[k] = float(p[k]);
+			v.normal[k] = float(n[k]);
+			v.color[k] = float(color[k]);
+		}
+		V.push_back(v);
+	};
+
+	if(curve)
+	{
+		// Color each sample by its segment index
+		const vector<pair<Pt3, int>> &P = _scene->getCurve();
+		V.reserve(P.size());
+		for(const auto &p: P)
+		{
+			const int a = p.second % 3;
+			const double color[3] = {double(a == 0), double(a == 1), double(a == 2)};
+			addVertex(p.first, Vec3(0, 0, 1, 0), color);
+		}
+	}
+	else
+	{
+		// Color for viewing a normal directly (no lighting)
+		auto normColor = [&](const auto &norm, double color[3])
+		{
+			// Scheme 1
+			/*
+			double sum = 0;
+			FOR(i,0,3)
+			{
+				double a = abs(norm[i]);
+				sum += color[i] = a;
+			}
+			FOR(i,0,3) color[i] /= sum;
+			//*/
+
+			// Scheme 2
+			FOR(i,0,3) color[i] = ((norm[i] + 1) * 0.5) * (0.5 * abs(norm[i]) + 0.5);
+		};
+
+		if(const CompactMesh* m = _scene->getMesh())
+		{
+			V.reserve(3 * m->numTriangles());
+			if(getShadingModel() == SHADE_GOURAUD)
+			{
+				/*
+				 * Indexed, in the triangle order of the mesh (see MeshOptimizer):
+				 * the corners that take the vertex normal share one vertex. Don't
+				 * use the vertex normal if it's too different from the face normal;
+				 * such corners get a vertex of their own.
+				 */
+				const double threshold = 0.7;
+				vector<int> shared(m->numVertices(), -1);
+				I.reserve(3 * m->numTriangles());
+				FOR(j,0,m->numTriangles())
+				{
+					const Vec3f fn = m->getFNormal(j);
+					FOR(k,0,3)
+					{
+						const int i = m->getInd(j, k);
+						const Vec3f vn = m->getVNormal(i);
+						const bool smooth = (vn * fn) > threshold;
+						if(smooth and shared[i] >= 0)
+						{
+							I.push_back(shared[i]);
+							continue;
+						}
+						if(smooth)
+							shared[i] = SZ(V);
+						I.push_back(SZ(V));
+
+						const Vec3f &norm = smooth ? vn : fn;
+						double color[3];
+						normColor(norm, color);
+						addVertex(m->getPoint(i), norm, color);
+					}
+				}
+			}
+			else // Triangles are unrolled, since their corners take the face normal
+			{
+				FOR(j,0,m->numTriangles())
 				{
-					const TriInd& ti = inds->get(j);
-					FOR(k,0,3) glVertex3dv(&pts->get(ti[k])[0]);
+					const Vec3f fn = m->getFNormal(j);
+					double color[3];
+					normColor(fn, color);
+					FOR(k,0,3)
+						addVertex(m->getPoint(m->getInd(j, k)), fn, color);
 				}
-				glEnd();
 			}
 		}
 	}
+
+	_buffer.upload(V, I);
 }
 
 void MeshRenderer::initLights()
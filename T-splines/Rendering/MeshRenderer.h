@@ -2,6 +2,7 @@
 #define MESH_RENDERER_H
 
 #include "TMesh.h"
+#include "Rendering/VertexBuffer.h"
 
 class MeshRenderer
 {
@@ -9,6 +10,12 @@ protected:
 	TriMeshScene* _scene;
 	int _shadingModel;
 
+	// Retained geometry: rebuilt only when the scene's mesh/curve or the shading changes
+	VertexBuffer _buffer;
+	TriMeshScene* _builtScene;
+	unsigned _builtVersion;
+	int _builtShading;
+
 public:
 	bool drawWire;
 	bool useNormal;
@@ -19,6 +26,9 @@ public:
 		useNormal = true;
 		_scene = NULL;
 		_shadingModel = SHADE_FLAT;
+		_builtScene = NULL;
+		_builtVersion = 0;
+		_builtShading = -1;
 	}
 
 	virtual void setTriMeshScene(TriMeshScene* TMeshScene) { _scene = TMeshScene; initLights(); }
@@ -29,6 +39,8 @@ public:
 
 protected:
 	virtual void initLights();
+	// Upload the current curve/surface into '_buffer' if it changed
+	void updateBuffer();
 };
 
 #endif // MESH_RENDERER_H
\ No newline at end of file
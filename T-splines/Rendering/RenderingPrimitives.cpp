@@ -5,15 +5,31 @@ using namespace std;
 Mat4 SceneInfo::modelview0;
 Mat4 SceneInfo::rotate0;
 Mat4 SceneInfo::translate0;
+unsigned SceneInfo::cameraGen0 = 0;
 
-// Newell's method
-inline Vec3 triFaceNormal(const Pt3 &a, const Pt3 &b, const Pt3 &c, bool doNorm = true)
+// Unit normal of a triangle (the cross product of two edges)
+template <class Real>
+inline Vector<Real, 4> triFaceNormal(const Vector<Real, 4> &a, const Vector<Real, 4> &b, const Vector<Real, 4> &c)
 {
-	Vec3 res = cross(b-a, c-a) + cross(c-b, a-b) + cross(a-c, b-c);
-	if(doNorm) res.normalize();
+	Vector<Real, 4> res = cross(b-a, c-a);
+	res.normalize();
 	return res;
 }
 
+// Normals of all triangles into 'norms', in parallel
+template <class Real>
+static void faceNormals(const Vector<Real, 4>* pts, const TriInd* tris, int ntris, Vector<Real, 4>* norms)
+{
+	parallelFor(ntris, 4096, [&](int begin, int end)
+	{
+		FOR(j,begin,end)
+		{
+			const TriInd &tri = tris[j];
+			norms[j] = triFaceNormal(pts[tri[0]], pts[tri[1]], pts[tri[2]]);
+		}
+	});
+}
+
 Material* RenderingUtils::readMaterial(std::istream& str) {
 	Color amb,diff,spec;
 	double spece;
@@ -41,47 +57,127 @@ Light* RenderingUtils::readLight(std::istream& str) {
 	return ret;
 }
 
-Vec3Array* RenderingUtils::perVertexNormals(Pt3Array* pts, TriIndArray* tris) {
-	int ntris = tris->size();
-	int nverts = pts->size();
-
-	Vec3Array* norms = new Vec3Array();
-	norms->resize(nverts);
-	for(int i = 0; i < nverts; i++)
-		norms->get(i).zero();
-
-	for(int i = 0; i < ntris; i++) {
-		TriInd& tri = tris->get(i);
-		Pt3& a = pts->get(tri[0]);
-		Pt3& b = pts->get(tri[1]);
-		Pt3& c = pts->get(tri[2]);
-		Vec3 n = triFaceNormal(a,b,c);
-
-		for(int j = 0; j < 3; j++)
-			norms->get(tri[j]) += n;
+/*
+ * The normal of a vertex is the normalized sum of the normals of its
+ * triangles. Instead of scattering each triangle's normal to its vertices,
+ * every vertex gathers them through a vertex -> triangle adjacency (CSR: the
+ * triangles of vertex v are faces[first[v] .. first[v+1])), so the vertices
+ * are split between threads without any synchronization. Each vertex adds
+ * its triangles in increasing order: the result does not depend on the
+ * number of threads. On a single thread the normals are scattered directly,
+ * which makes the very same sums.
+ */
+template <class Real>
+DynArray<Vector<Real, 4>>* RenderingUtils::perVertexNormals(DynArray<Vector<Real, 4>>* pts, TriIndArray* tris, Arena* arena) {
+	typedef Vector<Real, 4> Vec;
+	const int ntris = tris->size();
+	const int nverts = pts->size();
+	const TriInd* T = tris->getData();
+
+	DynArray<Vec>* norms = new DynArray<Vec>(arena);
+	if(numThreads(max(ntris, nverts), 4096) <= 1) {
+		const Vec* P = pts->getData();
+		norms->resize(nverts); // zero vectors
+		Vec* N = norms->getData();
+		FOR(j,0,ntris) {
+			const Vec n = triFaceNormal(P[T[j][0]], P[T[j][1]], P[T[j][2]]);
+			FOR(k,0,3)
+				N[T[j][k]] += n;
+		}
+		FOR(v,0,nverts) {
+			N[v][3] = 0;
+			N[v].normalize();
+		}
+		return norms;
 	}
 
-	for(int i = 0; i < nverts; i++) {
-		norms->get(i)[3] = 0;
-		norms->get(i).normalize();
-	}
+	DynArray<Vec> fnorms(arena);
+	fnorms.resizeUninit(ntris);
+	faceNormals(pts->getData(), T, ntris, fnorms.getData());
+
+	// Count the triangles of each vertex into first[v+1], then make them offsets
+	DynArray<int> first(arena), faces(arena);
+	first.resize(nverts + 1);
+	faces.resizeUninit(3 * ntris);
+	int* F = first.getData();
+	FOR(j,0,ntris) FOR(k,0,3)
+		F[T[j][k] + 1]++;
+	FOR(v,0,nverts)
+		F[v + 1] += F[v];
+	// Fill in increasing triangle order (F[v] moves to the start of v+1), then shift back
+	FOR(j,0,ntris) FOR(k,0,3)
+		faces.getData()[F[T[j][k]]++] = j;
+	for(int v = nverts; v > 0; v--)
+		F[v] = F[v - 1];
+	F[0] = 0;
+
+	norms->resizeUninit(nverts);
+	const Vec* FN = fnorms.getData();
+	const int* faceOf = faces.getData();
+	Vec* N = norms->getData();
+	parallelFor(nverts, 4096, [&](int begin, int end)
+	{
+		FOR(v,begin,end)
+		{
+			Vec n; // zero
+			FOR(i,F[v],F[v+1])
+				n += FN[faceOf[i]];
+			n[3] = 0;
+			n.normalize();
+			N[v] = n;
+		}
+	});
 
 	return norms;
 }
 
-Vec3Array* RenderingUtils::perFaceNormals(Pt3Array* pts, TriIndArray* tris) {
-	Vec3Array* norms = new Vec3Array();
-	int ntris = tris->size();
+template <class Real>
+DynArray<Vector<Real, 4>>* RenderingUtils::perFaceNormals(DynArray<Vector<Real, 4>>* pts, TriIndArray* tris, Arena* arena) {
+	DynArray<Vector<Real, 4>>* norms = new DynArray<Vector<Real, 4>>(arena);
+	norms->resizeUninit(tris->size());
+	faceNormals(pts->getData(), tris->getData(), tris->size(), norms->getData());
+	return norms;
+}
 
-	for(int j = 0; j < ntris; j++) {
-		TriInd& tri = tris->get(j);
-		Pt3& a = pts->get(tri[0]);
-		Pt3& b = pts->get(tri[1]);
-		Pt3& c = pts->get(tri[2]);
-		norms->add(triFaceNormal(a,b,c));
+template Vec3Array* RenderingUtils::perVertexNormals<double>(Pt3Array*, TriIndArray*, Arena*);
+template Vec3Array* RenderingUtils::perFaceNormals<double>(Pt3Array*, TriIndArray*, Arena*);
+template Vec3fArray* RenderingUtils::perVertexNormals<float>(Pt3fArray*, TriIndArray*, Arena*);
+template Vec3fArray* RenderingUtils::perFaceNormals<float>(Pt3fArray*, TriIndArray*, Arena*);
+
+/*
+ * The normal is projected onto the octahedron |x| + |y| + |z| = 1, whose
+ * lower half is folded over the upper one: (x, y) then covers the square
+ * [-1, 1]^2, stored as two snorm16 values (an angular error below 1e-4).
+ */
+unsigned RenderingUtils::encodeNormal(double x, double y, double z)
+{
+	const double l1 {abs(x) + abs(y) + abs(z)};
+	if(not (l1 > 0)) // degenerate triangles
+		return encodeNormal(0, 0, 1);
+	double u {x / l1}, v {y / l1};
+	if(z < 0)
+	{
+		const double fu {(1 - abs(v)) * (u < 0 ? -1 : 1)};
+		v = (1 - abs(u)) * (v < 0 ? -1 : 1);
+		u = fu;
 	}
+	auto snorm16 = [](double a) { return unsigned(lround(max(-1.0, min(1.0, a)) * 32767)) & 0xFFFF; };
+	return snorm16(u) | snorm16(v) << 16;
+}
 
-	return norms;
+Vec3f RenderingUtils::decodeNormal(unsigned code)
+{
+	float u {short(code & 0xFFFF) / 32767.f}, v {short(code >> 16) / 32767.f};
+	const float z {1 - abs(u) - abs(v)};
+	if(z < 0)
+	{
+		const float fu {(1 - abs(v)) * (u < 0 ? -1 : 1)};
+		v = (1 - abs(u)) * (v < 0 ? -1 : 1);
+		u = fu;
+	}
+	Vec3f n(u, v, z, 0);
+	n.normalize();
+	return n;
 }
 
 
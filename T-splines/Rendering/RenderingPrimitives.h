@@ -2,28 +2,84 @@
 #define RENDERING_PRIMITIVES_H
 
 #include "Common/Common.h"
+#include "Common/Arena.h"
+
+#include <cstring>
+#include <type_traits>
 
 using namespace std;
 
-// using a self-made dynamic array might make things a little faster
+/*
+ * A growable array (using a self-made dynamic array might make things a
+ * little faster). The storage is raw memory from the heap or, if given, an
+ * Arena: growing moves the elements over (a copy for trivially copyable
+ * types) and only the new elements are constructed. Arena blocks are left
+ * behind on growth, so size arena arrays up front with recap().
+ */
 template<typename T>
 class DynArray {
 protected:
 	T* _data;
 	int _size, _cap;
+	Arena* _arena; // owns the storage if set
+
+	// Destroy the elements from i on
+	void destroy(int i) {
+		if(not is_trivially_destructible<T>::value)
+			for(int j = i; j < _size; j++) _data[j].~T();
+	}
+
+	void release() {
+		destroy(0);
+		if(_data and not _arena) ::operator delete(_data);
+		_data = NULL;
+		_size = _cap = 0;
+	}
+
+	int grownCap() const { return max<int>(_size + 1, max<int>(10, int(_cap * 1.5))); }
+
 public:
-	DynArray() {
+	explicit DynArray(Arena* arena = NULL) {
 		_data = NULL;
 		_size = 0;
 		_cap = 0;
-		recap(10);
+		_arena = arena;
+	}
+
+	DynArray(DynArray&& other) : _data(other._data), _size(other._size), _cap(other._cap), _arena(other._arena) {
+		other._data = NULL;
+		other._size = other._cap = 0;
 	}
 
-	~DynArray() {
-		if(_data) delete [] _data;
+	DynArray& operator=(DynArray&& other) {
+		if(this != &other) {
+			release();
+			swap(_data, other._data);
+			swap(_size, other._size);
+			swap(_cap, other._cap);
+			_arena = other._arena;
+		}
+		return *this;
 	}
 
+	DynArray(const DynArray&) = delete;
+	DynArray& operator=(const DynArray&) = delete;
+
+	~DynArray() { release(); }
+
+	// New elements are value-initialized
 	void resize(int s) {
+		if(s > _cap)
+			recap(s);
+		destroy(s);
+		for(int j = _size; j < s; j++)
+			new (_data + j) T();
+		_size = s;
+	}
+
+	// Like resize(), but new elements are left as is: write them before reading
+	void resizeUninit(int s) {
+		static_assert(is_trivially_copyable<T>::value, "DynArray::resizeUninit needs trivially copyable elements");
 		if(s > _cap)
 			recap(s);
 		_size = s;
@@ -31,19 +87,32 @@ public:
 
 	int size() const { return _size; }
 
+	// The capacity is kept
 	void clear() {
+		destroy(0);
 		_size = 0;
-		if(data) {
-			delete [] _data;
-			_data = NULL;
-		}
-		recap(10);
 	}
 
 	void add(const T& p) {
-		if(_size >= _cap)
-			recap(max<int>(_size + 1, int(_cap * 1.5)));
-		_data[_size++] = p;
+		if(_size >= _cap) {
+			T copy(p); // 'p' may be an element
+			recap(grownCap());
+			new (_data + _size) T(move(copy));
+		}
+		else
+			new (_data + _size) T(p);
+		_size++;
+	}
+
+	void add(T&& p) {
+		if(_size >= _cap) {
+			T tmp(move(p));
+			recap(grownCap());
+			new (_data + _size) T(move(tmp));
+		}
+		else
+			new (_data + _size) T(move(p));
+		_size++;
 	}
 
 	T& get(int i) {
@@ -55,23 +124,37 @@ public:
 		return _data[i];
 	}
 
-	T* getData() { return _T; }
+	T* getData() { return _data; }
+	const T* getData() const { return _data; }
 
+	// Set the capacity to r elements (at least the size)
 	void recap(int r) {
-		_cap = r;
-		T* ndata = new T[_cap];
-		if(_data != NULL) {
-			for(int j = 0; j < _size; j++)
-				ndata[j] = move(_data[j]);
-			delete [] _data;
+		r = max(r, _size);
+		if(r == _cap)
+			return;
+		T* ndata = _arena ? _arena->allocate<T>(r) : (T*) ::operator new(size_t(r) * sizeof(T));
+		if(is_trivially_copyable<T>::value) {
+			if(_size > 0)
+				memcpy((void*) ndata, (const void*) _data, _size * sizeof(T));
 		}
+		else {
+			for(int j = 0; j < _size; j++) {
+				new (ndata + j) T(move(_data[j]));
+				_data[j].~T();
+			}
+		}
+		if(_data and not _arena)
+			::operator delete(_data);
 		_data = ndata;
+		_cap = r;
 	}
 };
 
 typedef DynArray<Pt3> Pt3Array;
 typedef DynArray<Vec3> Vec3Array;
 typedef DynArray<Color> ColorArray;
+typedef DynArray<Pt3f> Pt3fArray;
+typedef DynArray<Vec3f> Vec3fArray;
 
 typedef Vector<int,3> TriInd;
 
@@ -129,14 +212,16 @@ private:
 	static Mat4 modelview0;
 	static Mat4 translate0;
 	static Mat4 rotate0;
+	static unsigned cameraGen0; // bumped whenever the camera changes
 
 public:
 	Mat4 *getModelview() { return &modelview0; }
 	Mat4 *getTranslate() { return &translate0; }
 	Mat4 *getRotate() { return &rotate0; }
+	static unsigned getCameraGen() { return cameraGen0; }
 
 	static void initScene();
-	static inline void updateModelView() { modelview0 = translate0 * rotate0; }
+	static inline void updateModelView() { modelview0 = translate0 * rotate0; ++cameraGen0; }
 };
 
 class RenderingUtils {
@@ -144,8 +229,15 @@ public:
 	static Material* readMaterial(istream& mat);
 	static Light* readLight(istream& str);
 
-	static Vec3Array* perVertexNormals(Pt3Array* pts, TriIndArray* tris);
-	static Vec3Array* perFaceNormals(Pt3Array* pts, TriIndArray* tris);
+	// For double (Pt3) or float (Pt3f) points; the normals are stored in 'arena' if set
+	template <class Real>
+	static DynArray<Vector<Real, 4>>* perVertexNormals(DynArray<Vector<Real, 4>>* pts, TriIndArray* tris, Arena* arena = NULL);
+	template <class Real>
+	static DynArray<Vector<Real, 4>>* perFaceNormals(DynArray<Vector<Real, 4>>* pts, TriIndArray* tris, Arena* arena = NULL);
+
+	// Unit normals in 32 bits: octahedral projection, two 16-bit signed coordinates
+	static unsigned encodeNormal(double x, double y, double z);
+	static Vec3f decodeNormal(unsigned code);
 };
 
 #define SHADE_FLAT 0
@@ -5,10 +5,6 @@
 
 using namespace std;
 
-static int highlightDir = 0;
-static int highlightRow = 0;
-static int highlightCol = 0;
-
 static const double canvasMargin = 0.1;
 static const double canvasLen = 1 - canvasMargin * 2;
 
@@ -17,14 +13,18 @@ TopologyViewer::TopologyViewer(int x, int y, int w, int h, const char* l)
 	_w = w;
 	_h = h;
 	_mesh = NULL;
+	_parent = NULL;
+	_highlightDir = 0;
+	_highlightRow = 0;
+	_highlightCol = 0;
+	_drawnGen = 0;
+	_selecting = false;
+	_selectOn = false;
+	_selectR0 = _selectC0 = _selectR1 = _selectC1 = 0;
 	this->border(5);
-
-	Fl::repeat_timeout(REFRESH_RATE,TopologyViewer::updateCb,this);
 }
 
-TopologyViewer::~TopologyViewer() {
-	Fl::remove_timeout(TopologyViewer::updateCb,this);
-}
+TopologyViewer::~TopologyViewer() {}
 
 void TopologyViewer::set2DProjection()
 {
@@ -39,6 +39,8 @@ void TopologyViewer::set2DProjection()
 void TopologyViewer::draw()
 {
 	if(_mesh == NULL) return;
+	const TMesh &mesh {*_mesh}; // read only, so that no shared rows are copied
+	_drawnGen = mesh.topologyGen;
 
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 	glClearColor(0,0,0,1);
@@ -56,10 +58,10 @@ void TopologyViewer::draw()
 	static Color colorMark(0.5,0.5,0.5); // Marks for 1D-grid (gray)
 
 	// Draw grid lines (1D or 2D)
-	const double sx = (_mesh->cols > 0) ? canvasLen / _mesh->cols : 0;
-	const double sy = (_mesh->rows > 0) ? canvasLen / _mesh->rows : 0;
-	const double mx = (_mesh->cols > 0) ? canvasMargin : 0.5;
-	const double my = (_mesh->rows > 0) ? canvasMargin : 0.5;
+	const double sx = (mesh.cols > 0) ? canvasLen / mesh.cols : 0;
+	const double sy = (mesh.rows > 0) ? canvasLen / mesh.rows : 0;
+	const double mx = (mesh.cols > 0) ? canvasMargin : 0.5;
+	const double my = (mesh.rows > 0) ? canvasMargin : 0.5;
 
 	auto gridVertex2d = [&](double r, double c)
 	{
@@ -72,21 +74,21 @@ void TopologyViewer::draw()
 	glBegin(GL_LINES);
 	// Draw marks for 1D-grid
 	glColor3dv(&colorMark[0]);
-	if(_mesh->rows == 0)
+	if(mesh.rows == 0)
 	{
 		// Marks for H-lines
-		const double sx = canvasLen / _mesh->cols;
-		FOR(c,0,_mesh->cols + 1)
+		const double sx = canvasLen / mesh.cols;
+		FOR(c,0,mesh.cols + 1)
 		{
 			glVertex2d(c * sx + mx, 0.48);
 			glVertex2d(c * sx + mx, 0.52);
 		}
 	}
-	if(_mesh->cols == 0)
+	if(mesh.cols == 0)
 	{
 		// Marks for V-lines
-		const double sy = canvasLen / _mesh->rows;
-		FOR(r,0,_mesh->rows + 1)
+		const double sy = canvasLen / mesh.rows;
+		FOR(r,0,mesh.rows + 1)
 		{
 			glVertex2d(0.48, r * sy + my);
 			glVertex2d(0.52, r * sy + my);
@@ -96,15 +98,15 @@ void TopologyViewer::draw()
 
 
 	// Draw H-lines
-	FOR(r,0,_mesh->rows + 1) FOR(c,0,_mesh->cols)
+	FOR(r,0,mesh.rows + 1) FOR(c,0,mesh.cols)
 	{
 		// Thicken the highlighted line
-		if(highlightDir == 1 and r == highlightRow and c == highlightCol)
+		if(_highlightDir == 1 and r == _highlightRow and c == _highlightCol)
 			glLineWidth(3);
 		else
 			glLineWidth(1);
 
-		if(_mesh->gridH[r][c].on) // H-line active?
+		if(mesh.gridH[r][c].on) // H-line active?
 			glColor3dv(&colorActive[0]);
 		else
 			glColor3dv(&colorInactive[0]);
@@ -116,15 +118,15 @@ void TopologyViewer::draw()
 	}
 
 	// Draw V-lines
-	FOR(r,0,_mesh->rows) FOR(c,0,_mesh->cols + 1)
+	FOR(r,0,mesh.rows) FOR(c,0,mesh.cols + 1)
 	{
 		// Thicken the highlighted line
-		if(highlightDir == 2 and r == highlightRow and c == highlightCol)
+		if(_highlightDir == 2 and r == _highlightRow and c == _highlightCol)
 			glLineWidth(3);
 		else
 			glLineWidth(1);
 
-		if(_mesh->gridV[r][c].on) // V-line active?
+		if(mesh.gridV[r][c].on) // V-line active?
 			glColor3dv(&colorActive[0]);
 		else
 			glColor3dv(&colorInactive[0]);
@@ -136,14 +138,14 @@ void TopologyViewer::draw()
 	}
 
 
-	if(_mesh->rows * _mesh->cols > 0)
+	if(mesh.rows * mesh.cols > 0)
 	{
 		static Color colorBad(1, 0, 0); // Bad line (red)
 		static Color colorExtendH(0, 0.7, 0); // H-extension (green)
 		static Color colorExtendV(1, 0.5, 0); // V-extension (orange)
 
 		// Draw bad edges (red) and T-junction extensions (H:green, V:orange)
-		if(_mesh->validVertices)
+		if(mesh.validVertices)
 		{
 			// Make the line dashed
 			glPushAttrib(GL_ENABLE_BIT);
@@ -162,7 +164,7 @@ void TopologyViewer::draw()
 					doDraw = true;
 					glColor3dv(&colorBad[0]);
 				}
-				else if(_mesh->isAD and ei.extend) // draw T-j.e. only if AD
+				else if(mesh.isAD and ei.extend) // draw T-j.e. only if AD
 				{
 					doDraw = true;
 					if(isVert)
@@ -179,12 +181,12 @@ void TopologyViewer::draw()
 			};
 
 			// Draw bad H-edges or H-T-junction extensions
-			FOR(r,0,_mesh->rows + 1) FOR(c,0,_mesh->cols)
-				drawLine(_mesh->gridH[r][c], r, c, false);
+			FOR(r,0,mesh.rows + 1) FOR(c,0,mesh.cols)
+				drawLine(mesh.gridH[r][c], r, c, false);
 
 			// Draw bad V-edges or V-T-junction extensions
-			FOR(r,0,_mesh->rows) FOR(c,0,_mesh->cols + 1)
-				drawLine(_mesh->gridV[r][c], r, c, true);
+			FOR(r,0,mesh.rows) FOR(c,0,mesh.cols + 1)
+				drawLine(mesh.gridV[r][c], r, c, true);
 
 			glEnd();
 			glPopAttrib();
@@ -198,9 +200,9 @@ void TopologyViewer::draw()
 
 		glPointSize(6);
 		glBegin(GL_POINTS);
-		FOR(r,0,_mesh->rows + 1) FOR(c,0,_mesh->cols + 1)
+		FOR(r,0,mesh.rows + 1) FOR(c,0,mesh.cols + 1)
 		{
-			int vertexType = _mesh->gridPoints[r][c].valenceType;
+			int vertexType = mesh.gridPoints[r][c].valenceType;
 
 			if(vertexType == VALENCE_INVALID or vertexType >= 3)
 			{
@@ -218,14 +220,14 @@ void TopologyViewer::draw()
 
 
 		// Mark points that are intersections of V-H T-junction extensions
-		if(_mesh->validVertices and _mesh->isAD and not _mesh->isAS)
+		if(mesh.validVertices and mesh.isAD and not mesh.isAS)
 		{
 			glLineWidth(2);
 			glColor3d(1, 0, 0); // red
 			glBegin(GL_LINES);
-			FOR(r,0,_mesh->rows + 1) FOR(c,0,_mesh->cols + 1)
+			FOR(r,0,mesh.rows + 1) FOR(c,0,mesh.cols + 1)
 			{
-				if(_mesh->gridPoints[r][c].extendFlag == EXTENSION_BOTH)
+				if(mesh.gridPoints[r][c].extendFlag == EXTENSION_BOTH)
 				{
 					const double x = c * sx + mx;
 					const double y = r * sy + my;
@@ -239,9 +241,9 @@ void TopologyViewer::draw()
 		}
 
 		// Mark non-de-Boor unit elements
-		if(_mesh->isAS and not _mesh->isDS)
+		if(mesh.isAS and not mesh.isDS)
 		{
-			FOR(r,0,_mesh->rows) FOR(c,0,_mesh->cols) if(_mesh->blendDir[r][c] == DIR_NEITHER)
+			FOR(r,0,mesh.rows) FOR(c,0,mesh.cols) if(mesh.blendDir[r][c] == DIR_NEITHER)
 			{
 				const double margin_small {0.1};
 				const double margin_large {0.4};
@@ -262,44 +264,44 @@ void TopologyViewer::draw()
 		}
 
 		// Display the tiled floor of an anchor or the blending points for a unit element
-		if(_mesh->isAS and highlightDir >= 3)
+		if(mesh.isAS and mesh.isCubic() and _highlightDir >= 3)
 		{
 			auto getTiledFloorRange = [&](const int r, const int c, int& r_min, int& r_max, int& c_min, int& c_max)
 			{
 				auto onVSkel = [&](int r0)
 				{
-					return _mesh->gridPoints[r0][c].valenceType >= 3 or _mesh->gridPoints[r0][c].valenceBits == 12;
+					return mesh.gridPoints[r0][c].valenceType >= 3 or mesh.gridPoints[r0][c].valenceBits == 12;
 				};
 				auto onHSkel = [&](int c0)
 				{
-					return _mesh->gridPoints[r][c0].valenceType >= 3 or _mesh->gridPoints[r][c0].valenceBits == 3;
+					return mesh.gridPoints[r][c0].valenceType >= 3 or mesh.gridPoints[r][c0].valenceBits == 3;
 				};
 				r_min = r_max = r;
 				c_min = c_max = c;
 				FOR(k,0,2)
 				{
 					while(--r_min >= 0 and not onVSkel(r_min));
-					while(++r_max <= _mesh->rows and not onVSkel(r_max));
+					while(++r_max <= mesh.rows and not onVSkel(r_max));
 					while(--c_min >= 0 and not onHSkel(c_min));
-					while(++c_max <= _mesh->cols and not onHSkel(c_max));
+					while(++c_max <= mesh.cols and not onHSkel(c_max));
 				}
 				r_min = max(r_min, 0);
-				r_max = min(r_max, _mesh->rows);
+				r_max = min(r_max, mesh.rows);
 				c_min = max(c_min, 0);
-				c_max = min(c_max, _mesh->cols);
+				c_max = min(c_max, mesh.cols);
 			};
 
 			// Mark the point at which the cursor is pointing
-			if(highlightDir == 3)
+			if(_highlightDir == 3)
 			{
 				glPointSize(6);
 				glBegin(GL_POINTS);
 				glColor3d(1,0,1);
-				gridVertex2d(highlightRow, highlightCol);
+				gridVertex2d(_highlightRow, _highlightCol);
 				glEnd();
 
 				int r_min, r_max, c_min, c_max;
-				getTiledFloorRange(highlightRow, highlightCol, r_min, r_max, c_min, c_max);
+				getTiledFloorRange(_highlightRow, _highlightCol, r_min, r_max, c_min, c_max);
 
 				glColor3d(1,0,1);
 				glLineWidth(2);
@@ -313,12 +315,12 @@ void TopologyViewer::draw()
 
 
 			// Mark the unit element at which the cursor is pointing
-			if(highlightDir == 4)
+			if(_highlightDir == 4)
 			{
 				vector<pair<int,int>> blendP, blendP2, missing, extra;
 				bool row_n_4, col_n_4;
-				//_mesh->get16Points(highlightRow, highlightCol, blendP, row_n_4, col_n_4);
-				_mesh->test1(highlightRow, highlightCol, blendP, blendP2, missing, extra, row_n_4, col_n_4);
+				//mesh.get16Points(_highlightRow, _highlightCol, blendP, row_n_4, col_n_4);
+				mesh.test1(_highlightRow, _highlightCol, blendP, blendP2, missing, extra, row_n_4, col_n_4);
 
 				// Mark found or missing blending points (for testing the algorithms in the paper)
 				glBegin(GL_POINTS);
@@ -346,24 +348,24 @@ void TopologyViewer::draw()
 				// Show which directions the unit element can be rendered first
 				if(row_n_4 == col_n_4)
 				{
-					r0 = highlightRow + margin_small;
-					c0 = highlightCol + margin_small;
-					r1 = highlightRow + 1 - margin_small;
-					c1 = highlightCol + 1 - margin_small;
+					r0 = _highlightRow + margin_small;
+					c0 = _highlightCol + margin_small;
+					r1 = _highlightRow + 1 - margin_small;
+					c1 = _highlightCol + 1 - margin_small;
 				}
 				else if(row_n_4)
 				{
-					r0 = highlightRow + margin_large;
-					c0 = highlightCol + margin_small;
-					r1 = highlightRow + 1 - margin_large;
-					c1 = highlightCol + 1 - margin_small;
+					r0 = _highlightRow + margin_large;
+					c0 = _highlightCol + margin_small;
+					r1 = _highlightRow + 1 - margin_large;
+					c1 = _highlightCol + 1 - margin_small;
 				}
 				else // if(col_n_4)
 				{
-					r0 = highlightRow + margin_small;
-					c0 = highlightCol + margin_large;
-					r1 = highlightRow + 1 - margin_small;
-					c1 = highlightCol + 1 - margin_large;
+					r0 = _highlightRow + margin_small;
+					c0 = _highlightCol + margin_large;
+					r1 = _highlightRow + 1 - margin_small;
+					c1 = _highlightCol + 1 - margin_large;
 				}
 
 				glBegin(GL_QUADS);
@@ -378,11 +380,11 @@ void TopologyViewer::draw()
 				bool simplestOk {true};
 				FOR(dr,-1,3) FOR(dc,-1,3)
 				{
-					int r {highlightRow + dr};
-					int c {highlightCol + dc};
-					if(r >= 0 and r <= _mesh->rows and c >= 0 and c <= _mesh->cols)
+					int r {_highlightRow + dr};
+					int c {_highlightCol + dc};
+					if(r >= 0 and r <= mesh.rows and c >= 0 and c <= mesh.cols)
 					{
-						int vertexType = _mesh->gridPoints[r][c].valenceType;
+						int vertexType = mesh.gridPoints[r][c].valenceType;
 						if(vertexType < 3) simplestOk = false;
 					}
 					else simplestOk = false;
@@ -394,7 +396,7 @@ void TopologyViewer::draw()
 					glColor3d(1,0.5,0);
 					FOR(r,-1,3) FOR(c,-1,3)
 					{
-						gridVertex2d(highlightRow + r, highlightCol + c);
+						gridVertex2d(_highlightRow + r, _highlightCol + c);
 					}
 					glEnd();
 				}
@@ -404,16 +406,16 @@ void TopologyViewer::draw()
 					glPointSize(10);
 					glBegin(GL_POINTS);
 					glColor3d(1,0.1,0);
-					FOR(r,0,_mesh->rows+1) FOR(c,0,_mesh->cols+1)
+					FOR(r,0,mesh.rows+1) FOR(c,0,mesh.cols+1)
 					{
 						// ignore non-vertex
-						if(_mesh->gridPoints[r][c].valenceType < 3) continue;
+						if(mesh.gridPoints[r][c].valenceType < 3) continue;
 
 						int r_min, r_max, c_min, c_max;
 						getTiledFloorRange(r, c, r_min, r_max, c_min, c_max);
 
-						if(r_min <= highlightRow and highlightRow < r_max and
-								c_min <= highlightCol and highlightCol < c_max)
+						if(r_min <= _highlightRow and _highlightRow < r_max and
+								c_min <= _highlightCol and _highlightCol < c_max)
 						{
 							gridVertex2d(r, c);
 						}
@@ -423,16 +425,29 @@ void TopologyViewer::draw()
 
 				glBegin(GL_QUADS);
 				glColor3d(0,0.4,0);
-				gridVertex2d(highlightRow + 0.1, highlightCol + 0.1);
-				gridVertex2d(highlightRow + 0.9, highlightCol + 0.1);
-				gridVertex2d(highlightRow + 0.9, highlightCol + 0.9);
-				gridVertex2d(highlightRow + 0.1, highlightCol + 0.9);
+				gridVertex2d(_highlightRow + 0.1, _highlightCol + 0.1);
+				gridVertex2d(_highlightRow + 0.9, _highlightCol + 0.1);
+				gridVertex2d(_highlightRow + 0.9, _highlightCol + 0.9);
+				gridVertex2d(_highlightRow + 0.1, _highlightCol + 0.9);
 				glEnd();
 //*/
 			}
 		}
 	}
 
+	// Rectangle being selected
+	if(_selecting)
+	{
+		glLineWidth(1);
+		glColor3d(1,1,0);
+		glBegin(GL_LINE_LOOP);
+		gridVertex2d(_selectR0, _selectC0);
+		gridVertex2d(_selectR0, _selectC1);
+		gridVertex2d(_selectR1, _selectC1);
+		gridVertex2d(_selectR1, _selectC0);
+		glEnd();
+	}
+
 	swap_buffers();
 }
 
@@ -440,42 +455,103 @@ Pt3 TopologyViewer::win2Screen(int x, int y) {
 	return Pt3(double(x) / _w, double(y) / _h, 0);
 }
 
+void TopologyViewer::win2Grid(int x, int y, double &row, double &col)
+{
+	Pt3 p = win2Screen(x, y);
+	row = _mesh->rows * (p[1] - canvasMargin) / canvasLen;
+	col = _mesh->cols * (p[0] - canvasMargin) / canvasLen;
+}
+
+void TopologyViewer::beginEdit()
+{
+	if(_parent)
+		_parent->beginEdit();
+	else
+		_mesh->beginEdit();
+}
+
+void TopologyViewer::commitEdit()
+{
+	// The parent reflects the changes in the rendered scene
+	if(_parent)
+		_parent->commitEdit();
+	else
+	{
+		_mesh->commitEdit();
+		refresh();
+	}
+}
+
+void TopologyViewer::setEdgesInRect(bool on)
+{
+	const TMesh &mesh {*_mesh};
+	const double r0 {min(_selectR0, _selectR1)}, r1 {max(_selectR0, _selectR1)};
+	const double c0 {min(_selectC0, _selectC1)}, c1 {max(_selectC0, _selectC1)};
+	// Grid lines with both ends in the rectangle, except for the frame
+	const int rFirst {max(0, (int) ceil(r0))}, rLast {min(mesh.rows, (int) floor(r1))};
+	const int cFirst {max(0, (int) ceil(c0))}, cLast {min(mesh.cols, (int) floor(c1))};
+
+	// One transaction: derived info and views are updated once
+	beginEdit();
+	FOR(r,max(rFirst, 1),min(rLast, mesh.rows - 1) + 1) FOR(c,cFirst,cLast)
+		_mesh->setEdge(false, r, c, on);
+	FOR(r,rFirst,rLast) FOR(c,max(cFirst, 1),min(cLast, mesh.cols - 1) + 1)
+		_mesh->setEdge(true, r, c, on);
+	commitEdit();
+}
+
 int TopologyViewer::handle(int ev)
 {
 	if(ev==FL_PUSH)
 	{
-		if(Fl::event_button() == FL_LEFT_MOUSE and (highlightDir == 1 or highlightDir == 2))
+		const bool modifier {(Fl::event_state() & (FL_SHIFT | FL_CTRL)) != 0};
+		if(Fl::event_button() == FL_LEFT_MOUSE and modifier and _mesh->rows * _mesh->cols > 0)
 		{
-			if(highlightDir == 1) // toggle the H-line
-			{
-				_mesh->gridH[highlightRow][highlightCol].on =
-					not _mesh->gridH[highlightRow][highlightCol].on;
-			}
-			else if(highlightDir == 2) // toggle the V-line
-			{
-				_mesh->gridV[highlightRow][highlightCol].on =
-					not _mesh->gridV[highlightRow][highlightCol].on;
-			}
-			_mesh->updateMeshInfo();
-
-			// Reflect changes to the rendered scene
-			if(_parent)
-			{
-				_parent->updateControlPoints();
-				if(_mesh->isAS)
-					_parent->updateSurface();
-			}
+			// Shift+drag turns on all edges in a rectangle, Ctrl+drag turns them off
+			_selecting = true;
+			_selectOn = (Fl::event_state() & FL_SHIFT) != 0;
+			win2Grid(Fl::event_x(), Fl::event_y(), _selectR0, _selectC0);
+			_selectR1 = _selectR0;
+			_selectC1 = _selectC0;
+			redraw();
+		}
+		else if(Fl::event_button() == FL_LEFT_MOUSE and (_highlightDir == 1 or _highlightDir == 2))
+		{
+			// Toggle the H-line (1) or V-line (2)
+			const bool vertical {_highlightDir == 2};
+			const TMesh &mesh {*_mesh};
+			const bool on {(vertical ? mesh.gridV : mesh.gridH)[_highlightRow][_highlightCol].on};
+			beginEdit();
+			_mesh->setEdge(vertical, _highlightRow, _highlightCol, not on);
+			commitEdit();
 		}
 		return 1;  // must return 1 here to ensure FL_PUSH? is sent
 	}
-	else if(ev==FL_DRAG) {}
-	else if(ev==FL_RELEASE) {}
+	else if(ev==FL_DRAG)
+	{
+		if(_selecting)
+		{
+			win2Grid(Fl::event_x(), Fl::event_y(), _selectR1, _selectC1);
+			redraw();
+		}
+	}
+	else if(ev==FL_RELEASE)
+	{
+		if(_selecting)
+		{
+			_selecting = false;
+			win2Grid(Fl::event_x(), Fl::event_y(), _selectR1, _selectC1);
+			setEdgesInRect(_selectOn);
+			redraw();
+		}
+	}
 	else if(ev==FL_MOVE)
 	{
 		// Will highlight only when rows > 0 and cols > 0
 		if(_mesh->rows * _mesh->cols > 0)
 		{
-			highlightDir = 0; // no highlighted point
+			const int prevDir {_highlightDir}, prevRow {_highlightRow}, prevCol {_highlightCol};
+			_highlightDir = 0; // no highlighted point
 
 			Pt3 cursorPoint = win2Screen(Fl::event_x(), Fl::event_y());
 			double cursorRow = _mesh->rows * (cursorPoint[1] - canvasMargin) / canvasLen;
@@ -512,23 +588,23 @@ int TopologyViewer::handle(int ev)
 				{
 					if(distH <= distV) // cursor closest to some H-line
 					{
-						highlightDir = 1;
-						highlightRow = roundedRow;
-						highlightCol = (int) floor(cursorCol);
+						_highlightDir = 1;
+						_highlightRow = roundedRow;
+						_highlightCol = (int) floor(cursorCol);
 					}
 					else // cursor closest to some V-line
 					{
-						highlightDir = 2;
-						highlightRow = (int) floor(cursorRow);
-						highlightCol = roundedCol;
+						_highlightDir = 2;
+						_highlightRow = (int) floor(cursorRow);
+						_highlightCol = roundedCol;
 					}
 				}
 				else if(cursorRowIn and cursorColIn)
 				{
-					highlightDir = 4;
-					highlightRow = (int) floor(cursorRow);
-					highlightCol = (int) floor(cursorCol);
-//					printf("pointing at (%d, %d)\n", highlightRow, highlightCol);
+					_highlightDir = 4;
+					_highlightRow = (int) floor(cursorRow);
+					_highlightCol = (int) floor(cursorCol);
+//					printf("pointing at (%d, %d)\n", _highlightRow, _highlightCol);
 //					printf("rows %d cols %d\n", _mesh->rows, _mesh->cols);
 				}
 			}
@@ -537,10 +613,14 @@ int TopologyViewer::handle(int ev)
 					_mesh->gridPoints[roundedRow][roundedCol].valenceType >= 3)
 			{
 //				printf("pointing at (%d, %d)\n", roundedRow, roundedCol);
-				highlightDir = 3;
-				highlightRow = roundedRow;
-				highlightCol = roundedCol;
+				_highlightDir = 3;
+				_highlightRow = roundedRow;
+				_highlightCol = roundedCol;
 			}
+
+			if(_highlightDir != prevDir or
+					(_highlightDir != 0 and (_highlightRow != prevRow or _highlightCol != prevCol)))
+				redraw();
 		}
 	}
 	else if(ev==FL_KEYDOWN) {}
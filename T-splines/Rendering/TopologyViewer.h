@@ -15,6 +15,15 @@ protected:
 	TMesh *_mesh;
 	TopologyWindow *_parent;
 
+	// The highlighted grid item: 0: none, 1: H-line, 2: V-line, 3: vertex, 4: unit element
+	int _highlightDir;
+	int _highlightRow, _highlightCol;
+	unsigned _drawnGen; // topology generation of the last drawing
+
+	// Rectangle selection (grid coordinates) and whether it turns edges on
+	bool _selecting, _selectOn;
+	double _selectR0, _selectC0, _selectR1, _selectC1;
+
 public:
 	TopologyViewer(int x, int y, int w, int h, const char* l=0);
 	~TopologyViewer();
@@ -25,16 +34,25 @@ public:
 	int getHeight() { return _h; }
 
 	Pt3 win2Screen(int x, int y);
+	// Window position to (fractional) grid row and column
+	void win2Grid(int x, int y, double &row, double &col);
 	void set2DProjection();
 
 	void setMesh(TMesh *mesh) { _mesh = mesh; }
 	void setParent(TopologyWindow *tw) { _parent = tw; }
-
-	static void updateCb(void* userdata) {
-		TopologyViewer* viewer = (TopologyViewer*) userdata;
-		viewer->redraw();
-		Fl::repeat_timeout(REFRESH_RATE, TopologyViewer::updateCb,userdata);
+	// Redraw if the topology changed since the last drawing (highlight changes redraw from handle())
+	void refresh()
+	{
+		if(_mesh and _mesh->topologyGen != _drawnGen)
+			redraw();
 	}
+
+protected:
+	// Edit transactions, through the parent when there is one
+	void beginEdit();
+	void commitEdit();
+	// Turn all inner edges in the selected rectangle on or off
+	void setEdgesInRect(bool on);
 };
 
 
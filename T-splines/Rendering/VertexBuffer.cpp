@@ -0,0 +1,210 @@
+#include "Rendering/VertexBuffer.h"
+
+#include <cstddef>
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+#include <GL/glx.h>
+#endif
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+#ifndef GL_ARRAY_BUFFER
+#define GL_ARRAY_BUFFER 0x8892
+#endif
+#ifndef GL_ELEMENT_ARRAY_BUFFER
+#define GL_ELEMENT_ARRAY_BUFFER 0x8893
+#endif
+#ifndef GL_STATIC_DRAW
+#define GL_STATIC_DRAW 0x88E4
+#endif
+
+// OpenGL 1.5 buffer functions, resolved at run time (gl.h on Windows stops at 1.1)
+typedef void (APIENTRY *GenBuffersProc)(GLsizei n, GLuint *buffers);
+typedef void (APIENTRY *DeleteBuffersProc)(GLsizei n, const GLuint *buffers);
+typedef void (APIENTRY *BindBufferProc)(GLenum target, GLuint buffer);
+typedef void (APIENTRY *BufferDataProc)(GLenum target, ptrdiff_t size, const void *data, GLenum usage);
+
+static GenBuffersProc genBuffers = NULL;
+static DeleteBuffersProc deleteBuffers = NULL;
+static BindBufferProc bindBuffer = NULL;
+static BufferDataProc bufferData = NULL;
+
+static void *getProc(const char *name)
+{
+#if defined(_WIN32)
+	return (void*) wglGetProcAddress(name);
+#elif defined(__APPLE__)
+	return NULL; // use client arrays
+#else
+	return (void*) glXGetProcAddressARB((const GLubyte*) name);
+#endif
+}
+
+bool VertexBuffer::hasVBO()
+{
+	static int state = -1; // unknown
+	if(state < 0)
+	{
+		// Only trust the entry points if the context reports the version or extension
+		const char *version = (const char*) glGetString(GL_VERSION);
+		const char *ext = (const char*) glGetString(GL_EXTENSIONS);
+		if(version == NULL) // no current context yet
+			return false;
+
+		int major = 0, minor = 0;
+		sscanf(version, "%d.%d", &major, &minor);
+		const bool core = major > 1 or (major == 1 and minor >= 5);
+		const bool arb = ext and strstr(ext, "GL_ARB_vertex_buffer_object");
+
+		const char *suffix = core ? "" : "ARB";
+		auto load = [&](const char *name) { return getProc((string(name) + suffix).c_str()); };
+		if(core or arb)
+		{
+			genBuffers = (GenBuffersProc) load("glGenBuffers");
+			deleteBuffers = (DeleteBuffersProc) load("glDeleteBuffers");
+			bindBuffer = (BindBufferProc) load("glBindBuffer");
+			bufferData = (BufferDataProc) load("glBufferData");
+		}
+		state = (genBuffers and deleteBuffers and bindBuffer and bufferData) ? 1 : 0;
+	}
+	return state == 1;
+}
+
+void VertexBuffer::upload(vector<Vertex> &vertices)
+{
+	upload(vertices, vector<unsigned>());
+}
+
+void VertexBuffer::upload(vector<Vertex> &vertices, const vector<unsigned> &indices)
+{
+	_count = SZ(vertices);
+	_indexCount = SZ(indices);
+	_indexType = _count <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	if(_indexType == GL_UNSIGNED_SHORT)
+	{
+		_indexData.resize(indices.size() * sizeof(unsigned short));
+		unsigned short *data = (unsigned short*) _indexData.data();
+		FOR(i,0,_indexCount) data[i] = (unsigned short) indices[i];
+	}
+	else
+	{
+		_indexData.resize(indices.size() * sizeof(unsigned));
+		if(_indexCount > 0)
+			memcpy(_indexData.data(), indices.data(), _indexData.size());
+	}
+
+	if(hasVBO())
+	{
+		if(_vbo == 0)
+			genBuffers(1, &_vbo);
+		bindBuffer(GL_ARRAY_BUFFER, _vbo);
+		bufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * vertices.size(), vertices.data(), GL_STATIC_DRAW);
+		bindBuffer(GL_ARRAY_BUFFER, 0);
+		_data.clear();
+		if(_indexCount > 0)
+		{
+			if(_ibo == 0)
+				genBuffers(1, &_ibo);
+			bindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+			bufferData(GL_ELEMENT_ARRAY_BUFFER, _indexData.size(), _indexData.data(), GL_STATIC_DRAW);
+			bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+			_indexData.clear();
+		}
+	}
+	else
+	{
+		_data.swap(vertices);
+	}
+}
+
+void VertexBuffer::bind(bool useNormals, bool useColors) const
+{
+	// With a VBO bound, the pointers are offsets into it
+	const char *base = (const char*) _data.data();
+	if(_vbo)
+	{
+		bindBuffer(GL_ARRAY_BUFFER, _vbo);
+		base = NULL;
+	}
+
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, pos));
+	if(useNormals)
+	{
+		glEnableClientState(GL_NORMAL_ARRAY);
+		glNormalPointer(GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, normal));
+	}
+	if(useColors)
+	{
+		glEnableClientState(GL_COLOR_ARRAY);
+		glColorPointer(3, GL_FLOAT, sizeof(Vertex), base + offsetof(Vertex, color));
+	}
+}
+
+void VertexBuffer::unbind() const
+{
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_NORMAL_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	if(_vbo)
+		bindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexBuffer::draw(GLenum mode, bool useNormals, bool useColors) const
+{
+	if(_count == 0)
+		return;
+
+	bind(useNormals, useColors);
+	drawAll(mode);
+	unbind();
+}
+
+void VertexBuffer::drawAll(GLenum mode) const
+{
+	if(_indexCount == 0)
+		glDrawArrays(mode, 0, _count);
+	else if(_ibo and _indexData.empty())
+	{
+		bindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo);
+		glDrawElements(mode, _indexCount, _indexType, NULL);
+		bindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	}
+	else
+		glDrawElements(mode, _indexCount, _indexType, _indexData.data());
+}
+
+void VertexBuffer::drawInstances(GLenum mode, const vector<float> &offsets, bool useNormals, bool useColors) const
+{
+	if(_count == 0 or offsets.empty())
+		return;
+
+	bind(useNormals, useColors);
+	glMatrixMode(GL_MODELVIEW);
+	for(size_t i = 0; i + 2 < offsets.size(); i += 3)
+	{
+		glPushMatrix();
+		glTranslatef(offsets[i], offsets[i + 1], offsets[i + 2]);
+		drawAll(mode);
+		glPopMatrix();
+	}
+	unbind();
+}
+
+void VertexBuffer::release()
+{
+	if(_vbo)
+	{
+		deleteBuffers(1, &_vbo);
+		_vbo = 0;
+	}
+	if(_ibo)
+	{
+		deleteBuffers(1, &_ibo);
+		_ibo = 0;
+	}
+	_data.clear();
+	_indexData.clear();
+	_count = _indexCount = 0;
+}
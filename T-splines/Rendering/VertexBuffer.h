@@ -0,0 +1,63 @@
+#ifndef VERTEX_BUFFER_H
+#define VERTEX_BUFFER_H
+
+#include <FL/gl.h>
+
+#include "Common/Common.h"
+
+/*
+ * A retained array of vertices (position, normal, color) for the fixed-function
+ * pipeline, drawn in order or through indices. The data is uploaded once into
+ * buffer objects (OpenGL 1.5, loaded at run time) and drawn with a single call.
+ * Without VBO support it keeps the data in client memory and draws from vertex
+ * arrays (OpenGL 1.1), which every implementation, including Mesa's software
+ * rasterizers, has.
+ *
+ * A GL context must be current for upload(), draw() and release().
+ */
+class VertexBuffer
+{
+public:
+	struct Vertex
+	{
+		float pos[3];
+		float normal[3];
+		float color[3];
+	};
+
+	VertexBuffer() : _vbo(0), _ibo(0), _count(0), _indexCount(0), _indexType(GL_UNSIGNED_INT) {}
+	~VertexBuffer() {} // the buffer can only be freed with a current context
+
+	// Replace the contents (moves 'vertices' in; may be reused by the caller)
+	void upload(vector<Vertex> &vertices);
+	// The same, drawing the vertices through 'indices' (stored in 16 bits
+	// when there are at most 65536 vertices)
+	void upload(vector<Vertex> &vertices, const vector<unsigned> &indices);
+	// Draw all vertices as 'mode' (GL_TRIANGLES, GL_LINES...), optionally
+	// with their normals (lighting) and/or colors
+	void draw(GLenum mode, bool useNormals, bool useColors) const;
+	// Draw one copy per offset (x, y, z triples) with the arrays bound once;
+	// the fixed-function stand-in for instancing
+	void drawInstances(GLenum mode, const vector<float> &offsets, bool useNormals, bool useColors) const;
+	void release();
+
+	int size() const { return _count; }
+	bool empty() const { return _count == 0; }
+
+	// Whether vertex buffer objects are available (the context must be current)
+	static bool hasVBO();
+
+protected:
+	GLuint _vbo, _ibo;
+	int _count, _indexCount;
+	GLenum _indexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+	vector<Vertex> _data; // client copies, when there are no VBOs
+	vector<unsigned char> _indexData;
+
+	void bind(bool useNormals, bool useColors) const;
+	void unbind() const;
+	// glDrawArrays() or glDrawElements() of everything (arrays bound)
+	void drawAll(GLenum mode) const;
+};
+
+#endif // VERTEX_BUFFER_H
@@ -1,8 +1,13 @@
 #include "Rendering/ZBufferRenderer.h"
 #include "GUI/GeometryWindow.h"
 
+const int ZBufferRenderer::POINT_SPRITE_THRESHOLD;
+
 ZBufferRenderer::ZBufferRenderer() {
 	_visitor = new ZBufferVisitor();
+	_scene = NULL;
+	_builtScene = NULL;
+	_builtVersion = 0;
 	initScene();
 }
 
@@ -72,62 +77,38 @@ void ZBufferRenderer::draw()
 		glLineWidth(0);
 		glPointSize(0);
 
+		updateBuffers();
+
 		// Draw the control points
 		glColor3d(0.8, 0.8, 0.8);
-		FOR(r,0,_scene->rows + 1) FOR(c,0,_scene->cols + 1)
+		const int npoints {SZ(_centers) / 3};
+		if(npoints <= POINT_SPRITE_THRESHOLD)
 		{
-			if(_scene->useSphere(r, c))
-				_scene->gridSpheres[r][c].first->accept(_visitor, NULL);
+			_sphereMesh.drawInstances(GL_TRIANGLES, _centers, false, false);
 		}
-
-		// Draw links between adjacent control points
-		glLineWidth(3);
-		glBegin(GL_LINES);
-
-		// Draw H-links
-		FOR(r,0,_scene->rows + 1)
+		else
 		{
-			const Sphere *last = NULL, *curr;
-			FOR(c,0,_scene->cols + 1)
-			{
-				if(!_scene->useSphere(r, c))
-					continue;
-				curr = _scene->gridSpheres[r][c].first;
-				if(last)
-				{
-					if(_scene->getGridH()[r][c-1].on)
-						glColor3d(0, 0.4, 0.8); // greenish blue
-					else
-						glColor3d(0, 0.1, 0.2); // dark blue
-					glVertex3dv(&last->getCenter()[0]);
-					glVertex3dv(&curr->getCenter()[0]);
-				}
-				last = curr;
-			}
+			// Round points of about the spheres' size at the grid's center
+			GLdouble mv[16], proj[16];
+			GLint viewport[4];
+			glGetDoublev(GL_MODELVIEW_MATRIX, mv);
+			glGetDoublev(GL_PROJECTION_MATRIX, proj);
+			glGetIntegerv(GL_VIEWPORT, viewport);
+
+			double center[3] {0, 0, 0};
+			FOR(i,0,npoints) FOR(k,0,3) center[k] += _centers[i * 3 + k] / npoints;
+			double w {mv[3] * center[0] + mv[7] * center[1] + mv[11] * center[2] + mv[15]};
+			w = proj[11] * (mv[2] * center[0] + mv[6] * center[1] + mv[10] * center[2] + mv[14]) + proj[15] * w;
+			const double pixels {_scene->radius * abs(proj[5]) * viewport[3] / max(1e-6, abs(w))};
+
+			glPointSize(float(max(2.0, min(32.0, pixels))));
+			_points.draw(GL_POINTS, false, false);
+			glPointSize(1);
 		}
 
-		// Draw V-links
-		FOR(c,0,_scene->cols + 1)
-		{
-			const Sphere *last = NULL, *curr;
-			FOR(r,0,_scene->rows + 1)
-			{
-				if(!_scene->useSphere(r, c))
-					continue;
-				curr = _scene->gridSpheres[r][c].first;
-				if(last)
-				{
-					if(_scene->getGridV()[r-1][c].on)
-						glColor3d(0.8, 0.4, 0); // orange
-					else
-						glColor3d(0.2, 0.1, 0); // brown
-					glVertex3dv(&last->getCenter()[0]);
-					glVertex3dv(&curr->getCenter()[0]);
-				}
-				last = curr;
-			}
-		}
-		glEnd();
+		// Draw links between adjacent control points
+		glLineWidth(3);
+		_links.draw(GL_LINES, false, true);
 
 		glLineWidth(0);
 		glPointSize(0);
@@ -166,6 +147,108 @@ void ZBufferRenderer::draw()
 	}
 }
 
+void ZBufferRenderer::updateBuffers()
+{
+	if(_builtScene == _scene and _builtVersion == _scene->getVersion())
+		return;
+	_builtScene = _scene;
+	_builtVersion = _scene->getVersion();
+
+	auto vertex = [](const Pt3 &p, double r, double g, double b)
+	{
+		VertexBuffer::Vertex v;
+		FOR(k,0,3)
+		{
+			v.pos[k] = float(p[k]);
+			v.normal[k] = 0;
+		}
+		v.color[0] = float(r);
+		v.color[1] = float(g);
+		v.color[2] = float(b);
+		return v;
+	};
+
+	// One sphere mesh, centered at the origin
+	if(_sphereMesh.empty())
+	{
+		const int slices {16}, stacks {12};
+		const double r {_scene->radius};
+		auto at = [&](int i, int j)
+		{
+			const double theta {M_PI * i / stacks};
+			const double phi {2 * M_PI * j / slices};
+			return Pt3(r * sin(theta) * cos(phi), r * sin(theta) * sin(phi), r * cos(theta));
+		};
+
+		vector<VertexBuffer::Vertex> V;
+		FOR(i,0,stacks) FOR(j,0,slices)
+		{
+			V.push_back(vertex(at(i, j), 1, 1, 1));
+			V.push_back(vertex(at(i + 1, j), 1, 1, 1));
+			V.push_back(vertex(at(i + 1, j + 1), 1, 1, 1));
+			V.push_back(vertex(at(i, j), 1, 1, 1));
+			V.push_back(vertex(at(i + 1, j + 1), 1, 1, 1));
+			V.push_back(vertex(at(i, j + 1), 1, 1, 1));
+		}
+		_sphereMesh.upload(V);
+	}
+
+	// Active control points
+	vector<VertexBuffer::Vertex> P;
+	_centers.clear();
+	FOR(r,0,_scene->rows + 1) FOR(c,0,_scene->cols + 1)
+	{
+		if(not _scene->useSphere(r, c))
+			continue;
+		const Pt3 &p = _scene->gridSpheres[r][c].first->getCenter();
+		FOR(k,0,3) _centers.push_back(float(p[k]));
+		P.push_back(vertex(p, 1, 1, 1));
+	}
+	_points.upload(P);
+
+	// Links between adjacent control points
+	vector<VertexBuffer::Vertex> L;
+
+	// H-links: greenish blue if on, dark blue otherwise
+	FOR(r,0,_scene->rows + 1)
+	{
+		const Sphere *last = NULL, *curr;
+		FOR(c,0,_scene->cols + 1)
+		{
+			if(!_scene->useSphere(r, c))
+				continue;
+			curr = _scene->gridSpheres[r][c].first;
+			if(last)
+			{
+				const bool on {_scene->getGridH()[r][c-1].on};
+				L.push_back(vertex(last->getCenter(), 0, on ? 0.4 : 0.1, on ? 0.8 : 0.2));
+				L.push_back(vertex(curr->getCenter(), 0, on ? 0.4 : 0.1, on ? 0.8 : 0.2));
+			}
+			last = curr;
+		}
+	}
+
+	// V-links: orange if on, brown otherwise
+	FOR(c,0,_scene->cols + 1)
+	{
+		const Sphere *last = NULL, *curr;
+		FOR(r,0,_scene->rows + 1)
+		{
+			if(!_scene->useSphere(r, c))
+				continue;
+			curr = _scene->gridSpheres[r][c].first;
+			if(last)
+			{
+				const bool on {_scene->getGridV()[r-1][c].on};
+				L.push_back(vertex(last->getCenter(), on ? 0.8 : 0.2, on ? 0.4 : 0.1, 0));
+				L.push_back(vertex(curr->getCenter(), on ? 0.8 : 0.2, on ? 0.4 : 0.1, 0));
+			}
+			last = curr;
+		}
+	}
+	_links.upload(L);
+}
+
 void ZBufferRenderer::drawGrid(double low, double high, int steps)
 {
 	double diff = (high - low) / steps;
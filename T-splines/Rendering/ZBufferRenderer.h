@@ -6,6 +6,7 @@
 #include <FL/glu.h>
 
 #include "Rendering/ShadeAndShapes.h"
+#include "Rendering/VertexBuffer.h"
 
 #include "TMesh.h"
 
@@ -24,7 +25,20 @@ protected:
 	bool _drawGrid;
 	bool _drawControlPoints;
 
+	// Control points and links, rebuilt only when the scene's version changes
+	VertexBuffer _sphereMesh; // one control point, tessellated once
+	VertexBuffer _points; // all active control points (for big grids)
+	VertexBuffer _links; // H/V links as line pairs
+	vector<float> _centers; // active control points (x, y, z)
+	TMeshScene* _builtScene;
+	unsigned _builtVersion;
+
+	void updateBuffers();
+
 public:
+	// Above this many control points, draw them as round points instead of spheres
+	static const int POINT_SPRITE_THRESHOLD = 2500;
+
 	ZBufferRenderer();
 
 	void initScene();
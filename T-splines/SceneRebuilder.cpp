@@ -0,0 +1,110 @@
+#include "SceneRebuilder.h"
+
+SceneRebuilder::SceneRebuilder()
+	: building(false), buildingMesh(false), quit(false), requested(0)
+{
+	worker = thread(&SceneRebuilder::run, this);
+}
+
+SceneRebuilder::~SceneRebuilder()
+{
+	lock.lock();
+	quit = true;
+	++requested; // cancels the build in progress, if any
+	lock.unlock();
+	wake.notify_one();
+	worker.join();
+}
+
+void SceneRebuilder::request(TMeshSnapshot snapshot, const SceneBuildSettings &settings)
+{
+	lock.lock();
+	pending = move(snapshot);
+	pendingView = NULL;
+	pendingSettings = settings;
+	ready = NULL; // already stale
+	++requested; // cancels the build in progress, if any
+	lock.unlock();
+	wake.notify_one();
+}
+
+bool SceneRebuilder::requestView(unique_ptr<SceneBuffer> buf, const SceneBuildSettings &settings)
+{
+	lock.lock();
+	if(pending or buildingMesh or (ready and not ready->viewUpdate))
+	{
+		lock.unlock();
+		return false;
+	}
+	pendingView = move(buf);
+	pendingSettings = settings;
+	ready = NULL;
+	++requested;
+	lock.unlock();
+	wake.notify_one();
+	return true;
+}
+
+void SceneRebuilder::cancel()
+{
+	lock_guard<mutex> guard(lock);
+	pending = NULL;
+	pendingView = NULL;
+	ready = NULL;
+	++requested;
+}
+
+unique_ptr<SceneBuffer> SceneRebuilder::poll()
+{
+	lock_guard<mutex> guard(lock);
+	return move(ready);
+}
+
+bool SceneRebuilder::busy() const
+{
+	lock_guard<mutex> guard(lock);
+	return pending or pendingView or building or ready;
+}
+
+void SceneRebuilder::run()
+{
+	unique_ptr<SceneBuffer> buf; // also holds a stale result until the next build
+	TMeshEvaluatorPtr last; // surface of the latest build, to reuse its anchors
+	unique_lock<mutex> guard(lock);
+	while(true)
+	{
+		wake.wait(guard, [this]() { return quit or pending or pendingView; });
+		if(quit)
+			return;
+
+		TMeshSnapshot mesh {move(pending)};
+		if(not mesh)
+			buf = move(pendingView);
+		const SceneBuildSettings settings {pendingSettings};
+		const unsigned ticket {requested};
+		building = true;
+		buildingMesh = bool(mesh);
+		guard.unlock();
+
+		// Build without the lock; give up as soon as a newer request arrives
+		auto cancelled = [&]() { return requested != ticket; };
+		bool done;
+		if(mesh)
+		{
+			buf.reset(new SceneBuffer);
+			buf->evaluator = last;
+			done = TriMeshScene::build(*mesh, settings, *buf, cancelled);
+			buf->source = move(mesh);
+			if(buf->evaluator)
+				last = buf->evaluator;
+		}
+		else
+			done = TriMeshScene::buildView(*buf, settings.options, cancelled);
+
+		guard.lock();
+		building = false;
+		buildingMesh = false;
+		if(done and requested == ticket)
+			ready = move(buf);
+	}
+}
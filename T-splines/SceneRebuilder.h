@@ -0,0 +1,61 @@
+#ifndef SCENE_REBUILDER_H
+#define SCENE_REBUILDER_H
+
+#include "TMesh.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+/*
+ * Rebuilds curves and surfaces on a background thread.
+ *
+ * request() hands over a mesh snapshot and returns at once; the worker
+ * compiles and tessellates it into a back buffer, which the UI thread picks up
+ * with poll() and swaps into its scene. A newer request supersedes the older
+ * ones: a pending snapshot is replaced, and a build in progress is cancelled,
+ * so only the latest edit is ever shown.
+ *
+ * View updates (the shown surface re-stitched for a new camera) go through
+ * the same worker, so that moving the camera never tessellates on the UI
+ * thread. They only supersede each other, never a mesh rebuild.
+ */
+class SceneRebuilder
+{
+public:
+	SceneRebuilder();
+	~SceneRebuilder();
+
+	// Rebuild from a snapshot of the mesh
+	void request(TMeshSnapshot snapshot, const SceneBuildSettings &settings);
+	/*
+	 * Re-stitch the shown surface for a new view ('buf' from
+	 * TriMeshScene::updateView()). Dropped, returning false, while a mesh
+	 * rebuild is pending, in progress or not yet taken: that surface is
+	 * shown first, and updated for the view afterwards.
+	 */
+	bool requestView(unique_ptr<SceneBuffer> buf, const SceneBuildSettings &settings);
+	// Drop the pending request and cancel the build in progress, if any
+	void cancel();
+	// Take the result of the latest request if it is done (and not yet taken)
+	unique_ptr<SceneBuffer> poll();
+	// Whether a request is pending, being built or done but not taken by poll()
+	bool busy() const;
+
+private:
+	mutable mutex lock; // guards the fields below except 'requested'
+	condition_variable wake;
+	TMeshSnapshot pending; // snapshot of the latest request, until the worker takes it
+	unique_ptr<SceneBuffer> pendingView; // or view update of the latest request
+	SceneBuildSettings pendingSettings;
+	unique_ptr<SceneBuffer> ready; // result of the latest request
+	bool building;
+	bool buildingMesh; // 'building' from a snapshot (not a view update)
+	bool quit;
+	atomic<unsigned> requested; // number of the latest request
+	thread worker;
+
+	void run();
+};
+
+#endif // SCENE_REBUILDER_H
@@ -0,0 +1,163 @@
+#include "TCurveArcLength.h"
+
+// 5-point Gauss-Legendre nodes and weights on [-1, 1]
+static const double GL_X[5] = {
+	-0.906179845938664, -0.538469310105683, 0, 0.538469310105683, 0.906179845938664};
+static const double GL_W[5] = {
+	0.236926885056189, 0.478628670499366, 0.568888888888889, 0.478628670499366, 0.236926885056189};
+
+TCurveArcLength::TCurveArcLength(TCurveEvaluatorPtr c, double relTol)
+	: curve(move(c))
+{
+	const int nspans {curve->numSpans()};
+	if(nspans == 0) return;
+
+	const double tol {max(1e-15, relTol * curve->getSize())};
+	const int maxDepth {16};
+
+	// Split each span into pieces (in parallel), as (end parameter, length)
+	vector<vector<pair<double, double>>> parts(nspans);
+	parallelFor(nspans, 64, [&](int begin, int end)
+	{
+		vector<PyramidNode> layer(curve->getDegree() + 1);
+		FOR(i,begin,end)
+		{
+			function<void (double, double, double, int)> addPiece =
+				[&](double ta, double tb, double whole, int depth)
+			{
+				const double tm {(ta + tb) / 2};
+				const double L {integrate(i, ta, tm, layer.data())};
+				const double R {integrate(i, tm, tb, layer.data())};
+				if(depth >= maxDepth or abs(L + R - whole) <= tol)
+				{
+					parts[i].emplace_back(tm, L);
+					parts[i].emplace_back(tb, R);
+				}
+				else
+				{
+					addPiece(ta, tm, L, depth + 1);
+					addPiece(tm, tb, R, depth + 1);
+				}
+			};
+
+			const double ta {curve->getSpanStart(i)};
+			const double tb {curve->getSpanEnd(i)};
+			addPiece(ta, tb, integrate(i, ta, tb, layer.data()), 0);
+		}
+	});
+
+	// Accumulate the lengths into one monotone table
+	params.push_back(curve->getStart());
+	lengths.push_back(0);
+	FOR(i,0,nspans) for(auto &piece: parts[i])
+	{
+		params.push_back(piece._1);
+		lengths.push_back(lengths.back() + piece._2);
+		pieceSpans.push_back(i);
+	}
+}
+
+double TCurveArcLength::speed(int span, double t, PyramidNode *layer) const
+{
+	Vec3 d;
+	curve->evaluateSpan(span, t, layer, &d);
+	return mag(d);
+}
+
+double TCurveArcLength::integrate(int span, double ta, double tb, PyramidNode *layer) const
+{
+	const double h {(tb - ta) / 2};
+	const double m {(ta + tb) / 2};
+	double res {0};
+	FOR(k,0,5) res += GL_W[k] * speed(span, m + h * GL_X[k], layer);
+	return res * h;
+}
+
+double TCurveArcLength::invert(int k, double d, PyramidNode *layer) const
+{
+	const int span {pieceSpans[k]};
+	const double pieceLen {lengths[k + 1] - lengths[k]};
+	const double target {d - lengths[k]};
+	const double tol {1e-12 * max(1.0, getLength())};
+
+	double lo {params[k]};
+	double hi {params[k + 1]};
+	if(pieceLen <= tol) return lo;
+
+	// Newton's method on s(t) - d, kept inside the bracket [lo, hi]
+	double t {lo + (hi - lo) * target / pieceLen};
+	FOR(it,0,30)
+	{
+		const double f {integrate(span, params[k], t, layer) - target};
+		if(abs(f) <= tol) break;
+		if(f > 0) hi = t;
+		else lo = t;
+
+		// Take the Newton step if it stays inside, bisect otherwise
+		const double sp {speed(span, t, layer)};
+		const double tn {(sp > 1e-30) ? t - f / sp : lo};
+		t = (lo < tn and tn < hi) ? tn : (lo + hi) / 2;
+	}
+	return t;
+}
+
+double TCurveArcLength::paramAt(double d) const
+{
+	if(params.empty()) return curve->getStart();
+
+	PyramidScratch layer(curve->getDegree());
+	d = max(0.0, min(getLength(), d));
+	int k = int(upper_bound(begin(lengths), end(lengths), d) - begin(lengths)) - 1;
+	k = max(0, min(SZ(params) - 2, k));
+	return invert(k, d, layer.data());
+}
+
+Pt3 TCurveArcLength::pointAt(double d) const
+{
+	return curve->evaluate(paramAt(d));
+}
+
+void TCurveArcLength::pointsAt(const vector<double> &ds, VP3 &res) const
+{
+	res.resize(ds.size());
+	if(params.empty())
+	{
+		for(auto &p: res) p = curve->evaluate(curve->getStart());
+		return;
+	}
+
+	vector<PyramidNode> layer(curve->getDegree() + 1);
+	const bool sorted {is_sorted(begin(ds), end(ds))};
+	const double length {getLength()};
+	int k {0};
+	FOR(i,0,SZ(ds))
+	{
+		const double d {max(0.0, min(length, ds[i]))};
+		if(sorted) // sweep forward through the table
+		{
+			while(k + 2 < SZ(params) and lengths[k + 1] <= d) ++k;
+		}
+		else
+		{
+			k = int(upper_bound(begin(lengths), end(lengths), d) - begin(lengths)) - 1;
+			k = max(0, min(SZ(params) - 2, k));
+		}
+		res[i] = curve->evaluateSpan(pieceSpans[k], invert(k, d, layer.data()), layer.data());
+	}
+}
+
+void TCurveArcLength::pointsAtSpacing(double step, VP3 &res) const
+{
+	const double length {getLength()};
+	vector<double> ds;
+	if(step > 0)
+	{
+		const int n {int(floor(length / step + 1e-9))};
+		ds.reserve(n + 2);
+		FOR(i,0,n+1) ds.push_back(i * step);
+	}
+	else ds.push_back(0);
+	if(length - ds.back() > 1e-9 * max(1.0, length))
+		ds.push_back(length);
+	pointsAt(ds, res);
+}
@@ -0,0 +1,46 @@
+#ifndef T_CURVE_ARC_LENGTH_H
+#define T_CURVE_ARC_LENGTH_H
+
+#include "TCurveEvaluator.h"
+
+/*
+ * Arc-length reparameterization of a 1D T-mesh curve.
+ *
+ * Each span is split into pieces whose lengths are integrated with 5-point
+ * Gauss-Legendre quadrature (pieces are halved until the quadrature
+ * converges). The cumulative lengths form a monotone table, so a distance is
+ * located in O(log n), then refined inside its piece with safeguarded Newton
+ * steps. The table is immutable and can be shared between threads.
+ */
+class TCurveArcLength
+{
+public:
+	explicit TCurveArcLength(TCurveEvaluatorPtr curve, double relTol = 1e-10);
+
+	const TCurveEvaluatorPtr &getCurve() const { return curve; }
+	double getLength() const { return lengths.empty() ? 0 : lengths.back(); }
+
+	// Parameter t at arc length d from the start (clamped to [0, length])
+	double paramAt(double d) const;
+	// Point at arc length d from the start (clamped to [0, length])
+	Pt3 pointAt(double d) const;
+	// Points at the given arc lengths (fastest when the distances are sorted)
+	void pointsAt(const vector<double> &d, VP3 &res) const;
+	// Points at equal arc-length spacing 'step', including both ends
+	void pointsAtSpacing(double step, VP3 &res) const;
+
+private:
+	TCurveEvaluatorPtr curve;
+	vector<double> params; // piece boundaries (parameters)
+	vector<double> lengths; // cumulative arc lengths at 'params'
+	VI pieceSpans; // span index of each piece
+
+	double speed(int span, double t, PyramidNode *layer) const;
+	double integrate(int span, double ta, double tb, PyramidNode *layer) const;
+	// Parameter at arc length d inside piece k (lengths[k] <= d <= lengths[k+1])
+	double invert(int k, double d, PyramidNode *layer) const;
+};
+
+typedef shared_ptr<const TCurveArcLength> TCurveArcLengthPtr;
+
+#endif // T_CURVE_ARC_LENGTH_H
@@ -0,0 +1,172 @@
+#include "TCurveEvaluator.h"
+
+const double TCurveEvaluator::DEFAULT_CHORD_TOL = 1e-4;
+
+TCurveEvaluator::TCurveEvaluator(const TMesh &T)
+{
+	assert(T.rows * T.cols == 0);
+
+	if(T.rows == 0) // 1 x (C+1) grid
+	{
+		n = T.cols;
+		deg = T.degH;
+		knots = T.knotsH;
+		points.resize(n + 1);
+		FOR(i,0,n+1) points[i] = T.gridPoints[0][i].position;
+	}
+	else // (R+1) x 1 grid
+	{
+		n = T.rows;
+		deg = T.degV;
+		knots = T.knotsV;
+		points.resize(n + 1);
+		FOR(i,0,n+1) points[i] = T.gridPoints[i][0].position;
+	}
+
+	t0 = knots[deg - 1];
+	t1 = knots[n];
+
+	// Collect non-empty segments [knots[p], knots[p+1]]
+	for(int p = deg - 1; p < n; ++p)
+		if(knots[p] + 1e-9 < knots[p + 1])
+			spans.push_back(p);
+
+	Pt3 lo {points[0]}, hi {points[0]};
+	for(const Pt3 &q: points) FOR(k,0,3)
+	{
+		lo[k] = min(lo[k], q[k]);
+		hi[k] = max(hi[k], q[k]);
+	}
+	Vec3 d {hi - lo};
+	d[3] = 0;
+	size = mag(d);
+}
+
+int TCurveEvaluator::findSpan(double t) const
+{
+	if(spans.empty()) return -1;
+
+	// The last span starting at or before t
+	int lo {0}, hi {SZ(spans) - 1};
+	while(lo < hi)
+	{
+		int mid {(lo + hi + 1) / 2};
+		if(knots[spans[mid]] <= t) lo = mid;
+		else hi = mid - 1;
+	}
+	return lo;
+}
+
+Pt3 TCurveEvaluator::evaluate(double t) const
+{
+	const int i {findSpan(t)};
+	if(i < 0) return points[0];
+
+	PyramidScratch layer(deg);
+	return evaluateSpan(i, max(t0, min(t1, t)), layer.data());
+}
+
+Pt3 TCurveEvaluator::evaluateSpan(int i, double t, PyramidNode *layer, Vec3 *deriv) const
+{
+	const int p {spans[i]};
+
+	// Collect the initial control points for this segment
+	for(int j = 0; j <= deg; ++j)
+	{
+		layer[j].point = points[j + p - deg + 1];
+		populateKnotLR(layer[j], j + p, deg, knots.data(), SZ(knots));
+	}
+
+	// Evaluate at t - run the local de Boor Algorithm on this segment
+	return localDeBoor(deg, t, layer, deriv);
+}
+
+bool TCurveEvaluator::sameCurve(const TCurveEvaluator &other) const
+{
+	if(deg != other.deg or n != other.n or knots != other.knots)
+		return false;
+	FOR(i,0,n+1) FOR(k,0,3)
+		if(points[i][k] != other.points[i][k])
+			return false;
+	return true;
+}
+
+void TCurveEvaluator::sampleSpan(int i, double chordTol, PyramidNode *layer, vector<pair<Pt3, int>> &P) const
+{
+	const int p {spans[i]};
+	const double ta {knots[p]};
+	const double tb {knots[p + 1]};
+
+	// Start with a few pieces so that inflections within a span aren't missed
+	const int initial {max(2, deg)};
+	const int maxDepth {12};
+
+	// Squared distance of point m from the chord (a, b)
+	auto chordHeight2 = [](const Pt3 &a, const Pt3 &b, const Pt3 &m)
+	{
+		Vec3 ab {b - a};
+		Vec3 am {m - a};
+		ab[3] = am[3] = 0;
+		const double len2 {ab * ab};
+		if(len2 < 1e-30) return am * am;
+		const double u {max(0.0, min(1.0, (am * ab) / len2))};
+		Vec3 d {am - ab * u};
+		return d * d;
+	};
+
+	const double tol2 {chordTol * chordTol};
+	function<void (double, const Pt3&, double, const Pt3&, int)> refine =
+		[&](double u0, const Pt3 &a, double u1, const Pt3 &b, int depth)
+	{
+		const double um {(u0 + u1) / 2};
+		const Pt3 m {evaluateSpan(i, um, layer)};
+		if(depth < maxDepth and chordHeight2(a, b, m) > tol2)
+		{
+			refine(u0, a, um, m, depth + 1);
+			refine(um, m, u1, b, depth + 1);
+		}
+		else
+		{
+			P.emplace_back(a, p);
+			P.emplace_back(m, p);
+		}
+	};
+
+	Pt3 a {evaluateSpan(i, ta, layer)};
+	FOR(k,0,initial)
+	{
+		const double u0 {ta + (tb - ta) * k / initial};
+		const double u1 {ta + (tb - ta) * (k + 1) / initial};
+		const Pt3 b {evaluateSpan(i, u1, layer)};
+		refine(u0, a, u1, b, 0);
+		a = b;
+	}
+}
+
+void TCurveEvaluator::sample(vector<pair<Pt3, int>> &P, double chordTol) const
+{
+	P.clear();
+	if(spans.empty()) return;
+	if(chordTol <= 0)
+		chordTol = max(1e-12, DEFAULT_CHORD_TOL * size);
+
+	// Sample the spans independently, then concatenate them in order
+	vector<vector<pair<Pt3, int>>> parts(spans.size());
+	parallelFor(SZ(spans), 64, [&](int begin, int end)
+	{
+		vector<PyramidNode> layer(deg + 1); // scratch, one per thread
+		FOR(i,begin,end)
+			sampleSpan(i, chordTol, layer.data(), parts[i]);
+	});
+
+	size_t total {1};
+	for(auto &part: parts) total += part.size();
+	P.reserve(total);
+	for(auto &part: parts)
+		P.insert(end(P), begin(part), end(part));
+
+	// Close the curve with the end of the last span
+	vector<PyramidNode> layer(deg + 1);
+	const int last {SZ(spans) - 1};
+	P.emplace_back(evaluateSpan(last, knots[spans[last] + 1], layer.data()), spans[last]);
+}
@@ -0,0 +1,82 @@
+#ifndef T_CURVE_EVALUATOR_H
+#define T_CURVE_EVALUATOR_H
+
+#include "TMeshEvaluator.h"
+
+/*
+ * Scratch nodes for TCurveEvaluator::evaluateSpan() (degree + 1 of them):
+ * on the stack for the usual degrees, on the heap only above.
+ */
+class PyramidScratch
+{
+public:
+	explicit PyramidScratch(int deg)
+	{
+		if(deg + 1 > LOCAL)
+			heap.resize(deg + 1);
+	}
+	PyramidNode *data() { return heap.empty() ? local : heap.data(); }
+
+private:
+	static const int LOCAL = 8;
+	PyramidNode local[LOCAL];
+	vector<PyramidNode> heap;
+};
+
+/*
+ * An immutable evaluator for 1D T-meshes (B-spline curves), compiled from
+ * either a 1 x (C+1) grid (rows == 0) or an (R+1) x 1 grid (cols == 0).
+ *
+ * Like TMeshEvaluator, all queries are const and only touch caller memory,
+ * so an evaluator may be shared between threads without locking.
+ */
+class TCurveEvaluator
+{
+public:
+	// Default chord-height tolerance, relative to the control polygon's size
+	static const double DEFAULT_CHORD_TOL;
+
+	explicit TCurveEvaluator(const TMesh &T);
+
+	int getDegree() const { return deg; }
+	int numSpans() const { return SZ(spans); }
+	// Segment index p of span i (knots[p] <= t <= knots[p+1])
+	int getSpanIndex(int i) const { return spans[i]; }
+	double getSpanStart(int i) const { return knots[spans[i]]; }
+	double getSpanEnd(int i) const { return knots[spans[i] + 1]; }
+	double getStart() const { return t0; }
+	double getEnd() const { return t1; }
+	// Diagonal of the bounding box of the control points
+	double getSize() const { return size; }
+
+	// Span containing parameter t (clamped to the domain), or -1 if empty
+	int findSpan(double t) const;
+	// Evaluate the curve at t (clamped to the domain)
+	Pt3 evaluate(double t) const;
+	// Evaluate span i at t, using 'layer' (getDegree() + 1 nodes) as scratch
+	Pt3 evaluateSpan(int i, double t, PyramidNode *layer, Vec3 *deriv = NULL) const;
+	// Whether both evaluators describe the same curve (knots and control points)
+	bool sameCurve(const TCurveEvaluator &other) const;
+
+	/*
+	 * Sample the whole curve adaptively: each span is subdivided until the
+	 * chord height is below 'chordTol' (absolute; <= 0 means relative
+	 * DEFAULT_CHORD_TOL). Spans are processed in parallel. Each sample keeps
+	 * its segment index p for visualization.
+	 */
+	void sample(vector<pair<Pt3, int>> &P, double chordTol = 0) const;
+	// Sample span i adaptively, appending all points except the span's end
+	void sampleSpan(int i, double chordTol, PyramidNode *layer, vector<pair<Pt3, int>> &P) const;
+
+private:
+	int n, deg;
+	double t0, t1;
+	double size;
+	vector<double> knots;
+	VP3 points; // control points
+	VI spans; // segment indices p of non-empty spans
+};
+
+typedef shared_ptr<const TCurveEvaluator> TCurveEvaluatorPtr;
+
+#endif // T_CURVE_EVALUATOR_H
@@ -1,4 +1,7 @@
 #include "TMesh.h"
+#include "TCurveArcLength.h"
+#include "TMeshTessellator.h"
+#include "Rendering/MeshOptimizer.h"
 
 #include <iomanip>
 #include <fstream>
@@ -23,8 +26,8 @@ bool TMesh::validateDimensionsAndDegrees(int r, int c, int degV, int degH)
 	if(not ((c > 0 and 1 <= degH and degH <= c) or (c == 0 and degH == 0)))
 		return false;
 
-	// (For now) Restrict the surface degrees to be (3,3)
-	if(degH != 3 or degV != 3)
+	// Surfaces: degrees 1 to MAX_SURFACE_DEGREE (other than (3,3) for full grids only)
+	if(r > 0 and c > 0 and (degH > MAX_SURFACE_DEGREE or degV > MAX_SURFACE_DEGREE))
 		return false;
 
 	return true;
@@ -66,6 +69,9 @@ TMesh::TMesh(int r, int c, int dv, int dh, bool autoFill)
 	cols = c;
 	degV = dv;
 	degH = dh;
+	topologyGen = newTopologyGen();
+	knotsGen = geometryGen = 0;
+	editChanges = EDIT_NONE;
 
 	// Assign some uniform knot values
 	if(cols > 0)
@@ -106,8 +112,113 @@ TMesh::TMesh(int r, int c, int dv, int dh, bool autoFill)
 	updateMeshInfo();
 }
 
+TMesh::TMesh(const TMesh &T)
+	: rows(T.rows), cols(T.cols), degH(T.degH), degV(T.degV),
+	  knotsH(T.knotsH), knotsV(T.knotsV), gridH(T.gridH), gridV(T.gridV), gridPoints(T.gridPoints),
+	  validVertices(T.validVertices), isAD(T.isAD), isAS(T.isAS), isDS(T.isDS),
+	  knotsCols(T.knotsCols), knotsRows(T.knotsRows), blendDir(T.blendDir), localKnots(T.localKnots),
+	  topologyGen(T.topologyGen), knotsGen(T.knotsGen), geometryGen(T.geometryGen),
+	  editChanges(EDIT_NONE)
+{
+}
+
 TMesh::~TMesh() {}
 
+unsigned TMesh::newTopologyGen()
+{
+	static atomic<unsigned> next {1};
+	return next++;
+}
+
+void TMesh::publish()
+{
+	atomic_store(&published, TMeshSnapshot(make_shared<const TMesh>(*this)));
+}
+
+void TMesh::restore(const TMeshSnapshot &S)
+{
+	// The generations of a snapshot identify its content; the live ones only grow
+	const TMeshSnapshot cur {snapshot()};
+	const bool topology {not cur or cur->topologyGen != S->topologyGen};
+	const bool knots {not cur or cur->knotsGen != S->knotsGen};
+	const bool geometry {not cur or cur->geometryGen != S->geometryGen};
+
+	rows = S->rows;
+	cols = S->cols;
+	degH = S->degH;
+	degV = S->degV;
+	knotsH = S->knotsH;
+	knotsV = S->knotsV;
+	gridH = S->gridH;
+	gridV = S->gridV;
+	gridPoints = S->gridPoints;
+	validVertices = S->validVertices;
+	isAD = S->isAD;
+	isAS = S->isAS;
+	isDS = S->isDS;
+	knotsCols = S->knotsCols;
+	knotsRows = S->knotsRows;
+	blendDir = S->blendDir;
+	localKnots = S->localKnots;
+
+	if(topology) topologyGen = newTopologyGen();
+	if(knots) ++knotsGen;
+	if(geometry) ++geometryGen;
+	atomic_store(&published, S);
+}
+
+void TMesh::beginEdit()
+{
+	lock.lock();
+	editChanges = EDIT_NONE;
+}
+
+void TMesh::setEdge(bool vertical, int r, int c, bool on)
+{
+	const TMesh &T {*this}; // compare without copying a shared row
+	if((vertical ? T.gridV : T.gridH)[r][c].on == on)
+		return;
+	(vertical ? gridV : gridH)[r][c].on = on;
+	editChanges |= EDIT_TOPOLOGY;
+}
+
+void TMesh::setKnots(bool vertical, vector<double> knots)
+{
+	vector<double> &K {vertical ? knotsV : knotsH};
+	if(K == knots)
+		return;
+	K = move(knots);
+	editChanges |= EDIT_KNOTS;
+}
+
+void TMesh::setPosition(int r, int c, const Pt3 &p)
+{
+	gridPoints[r][c].position = p;
+	editChanges |= EDIT_GEOMETRY;
+}
+
+int TMesh::commitEdit()
+{
+	const int changes {editChanges};
+	editChanges = EDIT_NONE;
+
+	if(changes & EDIT_KNOTS)
+		++knotsGen;
+	if(changes & EDIT_GEOMETRY)
+		++geometryGen;
+	if(changes & EDIT_TOPOLOGY)
+		updateMeshInfo(); // also publishes
+	else if(changes != EDIT_NONE)
+	{
+		if(changes & EDIT_KNOTS)
+			updateLocalKnots();
+		publish();
+	}
+
+	lock.unlock();
+	return changes;
+}
+
 
 /*
 * Replaces the current content with a given T-mesh T using C++ move(),
@@ -126,6 +237,8 @@ void TMesh::assign(TMesh &T)
 	this->gridH = move(T.gridH);
 	this->gridV = move(T.gridV);
 	this->gridPoints = move(T.gridPoints);
+	++this->knotsGen;
+	++this->geometryGen;
 	this->updateMeshInfo();
 
 	this->lock.unlock();
@@ -332,7 +445,7 @@ bool TMesh::meshFromFile(const string &path)
 * Saves T-mesh information to the file specified by a given path.
 * Returns 1 on success, 0 on failure.
 */
-bool TMesh::meshToFile(const string &path)
+bool TMesh::meshToFile(const string &path) const
 {
 	// Try to open the file
 	ofstream fs(path);
@@ -342,13 +455,14 @@ bool TMesh::meshToFile(const string &path)
 		return false;
 	}
 
-	// Lock to prevent changes while saving the T-mesh
-	this->lock.lock();
+	// Save the last published state: editing may go on while writing
+	const TMeshSnapshot snap {snapshot()};
+	const TMesh &T {snap ? *snap : *this};
 
 	// Save dimensions and degrees
 	{
-		fs << this->rows << ' ' << this->cols << '\n';
-		fs << this->degV << ' ' << this->degH;
+		fs << T.rows << ' ' << T.cols << '\n';
+		fs << T.degV << ' ' << T.degH;
 	}
 
 	// Returns ' ' if x > 0 and '\n' otherwise
@@ -357,20 +471,20 @@ bool TMesh::meshToFile(const string &path)
 	// Save grid information
 	{
 		// - Horizontal: (R-1) x C bools
-		if(this->cols > 0)
+		if(T.cols > 0)
 		{
 			fs << '\n';
-			for(int r = 1; r < this->rows; ++r)
-				for(int c = 0; c < this->cols; ++c)
-					fs << separator(c) << (int)this->gridH[r][c].on;
+			for(int r = 1; r < T.rows; ++r)
+				for(int c = 0; c < T.cols; ++c)
+					fs << separator(c) << (int)T.gridH[r][c].on;
 		}
 		// - Vertical: R x (C-1) bools
-		if(this->rows > 0)
+		if(T.rows > 0)
 		{
 			fs << '\n';
-			for(int r = 0; r < this->rows; ++r)
-				for(int c = 1; c < this->cols; ++c)
-					fs << separator(c-1) << (int)this->gridV[r][c].on;
+			for(int r = 0; r < T.rows; ++r)
+				for(int c = 1; c < T.cols; ++c)
+					fs << separator(c-1) << (int)T.gridV[r][c].on;
 		}
 	}
 
@@ -382,36 +496,33 @@ bool TMesh::meshToFile(const string &path)
 
 		// - Horizontal: C + deg_H doubles
 		fs << "\n0 "; // Provide all by default
-		if(this->cols > 0)
+		if(T.cols > 0)
 		{
-			for(int i = 0; i < this->cols + this->degH; ++i)
-				fs << ' ' << this->knotsH[i];
+			for(int i = 0; i < T.cols + T.degH; ++i)
+				fs << ' ' << T.knotsH[i];
 		}
 		// - Vertical: R + deg_V doubles
 		fs << "\n0 "; // Provide all by default
-		if(this->rows > 0)
+		if(T.rows > 0)
 		{
-			for(int i = 0; i < this->rows + this->degV; ++i)
-				fs << ' ' << this->knotsV[i];
+			for(int i = 0; i < T.rows + T.degV; ++i)
+				fs << ' ' << T.knotsV[i];
 		}
 	}
 
 	// Save control point coordinates: (R+1) x (C+1) x 3 doubles
 	{
-		for(int r = 0; r <= this->rows; ++r)
+		for(int r = 0; r <= T.rows; ++r)
 		{
 			fs << '\n';
-			for(int c = 0; c <= this->cols; ++c)
+			for(int c = 0; c <= T.cols; ++c)
 			{
 				fs << '\n';
-				writePt3(fs, this->gridPoints[r][c].position);
+				writePt3(fs, T.gridPoints[r][c].position);
 			}
 		}
 	}
 
-	// Finish saving the T-mesh
-	this->lock.unlock();
-
 	// Signal the ending in the file
 	fs << "\n\nEND" << endl;
 
@@ -428,18 +539,24 @@ bool TMesh::isWithinGrid(int r, int c) const
 	return r >= 0 and r <= rows and c >= 0 and c <= cols;
 }
 
+bool TMesh::isFullGrid() const
+{
+	FOR(r,0,rows + 1) for(const EdgeInfo &e: gridH[r]) if(not e.on) return false;
+	FOR(r,0,rows) for(const EdgeInfo &e: gridV[r]) if(not e.on) return false;
+	return true;
+}
+
 bool TMesh::useVertex(int r, int c) const
 {
 	return isWithinGrid(r, c) and gridPoints[r][c].valenceType >= 3;
 }
 
-// Whether the current vertex (r,c) is skipped (depending on 'isVert')
-bool TMesh::isSkipped(int r, int c, bool isVert) const
+// Whether vertex v is skipped (depending on 'isVert')
+bool TMesh::isSkipped(const VertexInfo &v, bool isVert)
 {
-	const int bits = gridPoints[r][c].valenceBits;
-	return (isVert and bits == 0b0011) or
-		(not isVert and bits == 0b1100) or
-		gridPoints[r][c].valenceType == 0;
+	return (isVert and v.valenceBits == 0b0011) or
+		(not isVert and v.valenceBits == 0b1100) or
+		v.valenceType == 0;
 }
 
 void TMesh::cap(int& r, int& c) const
@@ -449,7 +566,7 @@ void TMesh::cap(int& r, int& c) const
 }
 
 // Mark vertices along the extension line (degrees - 1 steps forward, 1 step backward)
-void TMesh::markExtension(int r0, int c0, int dr, int dc, bool isVert, int& minRes, int& maxRes)
+void TMesh::markExtension(GridWork &W, int r0, int c0, int dr, int dc, bool isVert, int& minRes, int& maxRes) const
 {
 	const int val {isVert ? EXTENSION_VERTICAL : EXTENSION_HORIZONTAL};
 	int fwSteps {2};
@@ -462,15 +579,15 @@ void TMesh::markExtension(int r0, int c0, int dr, int dc, bool isVert, int& minR
 	while(fwSteps >= 0 and isWithinGrid(r, c))
 	{
 		int t;
-		gridPoints[r][c].extendFlag |= val;
+		W.points[r][c].extendFlag |= val;
 		if(isVert)
-			gridV[t = r - max(dr, 0)][c].extend = true;
+			W.V[t = r - max(dr, 0)][c].extend = true;
 		else
-			gridH[r][t = c - max(dc, 0)].extend = true;
+			W.H[r][t = c - max(dc, 0)].extend = true;
 		minRes = min(minRes, t);
 		maxRes = max(maxRes, t);
 
-		if(not isSkipped(r, c, isVert))
+		if(not isSkipped(W.points[r][c], isVert))
 			--fwSteps;
 		r += dr;
 		c += dc;
@@ -482,21 +599,35 @@ void TMesh::markExtension(int r0, int c0, int dr, int dc, bool isVert, int& minR
 	while(isWithinGrid(r, c))
 	{
 		int t;
-		gridPoints[r][c].extendFlag |= val;
+		W.points[r][c].extendFlag |= val;
 		if(isVert)
-			gridV[t = r + min(dr, 0)][c].extend = true;
+			W.V[t = r + min(dr, 0)][c].extend = true;
 		else
-			gridH[r][t = c + min(dc, 0)].extend = true;
+			W.H[r][t = c + min(dc, 0)].extend = true;
 		minRes = min(minRes, t);
 		maxRes = max(maxRes, t);
 
-		if(not isSkipped(r, c, isVert))
+		if(not isSkipped(W.points[r][c], isVert))
 			break;
 		r -= dr;
 		c -= dc;
 	}
 }
 
+// Store the rows of 'src' that differ from those of 'A' (by 'same'), so that unchanged rows stay shared
+template <class T, class Same>
+static void storeRows(SharedRows<T> &A, vector<vector<T>> &src, Same same)
+{
+	const SharedRows<T> &C {A};
+	A.resize(SZ(src));
+	FOR(i,0,SZ(src))
+	{
+		const vector<T> &row {C[i]};
+		if(SZ(row) != SZ(src[i]) or not equal(begin(row), end(row), begin(src[i]), same))
+			A.setRow(i, move(src[i]));
+	}
+}
+
 /*
  * Update implicit mesh information that is computed but not input
  * and also verify if
@@ -505,18 +636,58 @@ void TMesh::markExtension(int r0, int c0, int dr, int dc, bool isVert, int& minR
  *  3) whether the T-mesh is analysis-suitable (AS)
  *  4) whether the T-mesh is de Boor-suitable (DS)
  * The calling thread should lock the mutex before calling
+ *
+ * The info is derived in plain copies of the grids, and only the rows that
+ * end up different are stored back: the others stay shared with the
+ * snapshots (and the undo history), so an edit costs O(changed rows) memory.
  */
 void TMesh::updateMeshInfo()
 {
+	topologyGen = newTopologyGen();
 	validVertices = true;
 
+	const TMesh &T {*this}; // read without copying shared rows
+	GridWork W;
+	W.points.resize(rows + 1);
+	W.H.resize(rows + 1);
+	W.V.resize(rows);
+	FOR(r,0,rows + 1) W.points[r] = T.gridPoints[r];
+	FOR(r,0,rows + 1) W.H[r] = T.gridH[r];
+	FOR(r,0,rows) W.V[r] = T.gridV[r];
+	vector<VI> KC, KR, dir; // knotsCols, knotsRows and blendDir (AS only)
+
+	// Store the derived info, then publish
+	auto finish = [&]()
+	{
+		auto sameVertex = [](const VertexInfo &a, const VertexInfo &b)
+		{
+			return a.valenceBits == b.valenceBits and a.valenceType == b.valenceType and
+				a.extendFlag == b.extendFlag and a.vId == b.vId and a.hId == b.hId;
+		};
+		auto sameEdge = [](const EdgeInfo &a, const EdgeInfo &b)
+		{
+			return a.on == b.on and a.valid == b.valid and a.extend == b.extend;
+		};
+		storeRows(gridPoints, W.points, sameVertex);
+		storeRows(gridH, W.H, sameEdge);
+		storeRows(gridV, W.V, sameEdge);
+		if(not dir.empty()) // computed when checking AS
+		{
+			storeRows(knotsCols, KC, equal_to<int>());
+			storeRows(knotsRows, KR, equal_to<int>());
+			storeRows(blendDir, dir, equal_to<int>());
+		}
+		updateLocalKnots();
+		publish();
+	};
+
 	FOR(r,0,rows + 1) FOR(c,0,cols + 1)
 	{
-		int& valenceBits = gridPoints[r][c].valenceBits; // 0-3: directions UDLR
-		int& valenceType = gridPoints[r][c].valenceType; // 0:don't draw, 2-4:valence
+		int& valenceBits = W.points[r][c].valenceBits; // 0-3: directions UDLR
+		int& valenceType = W.points[r][c].valenceType; // 0:don't draw, 2-4:valence
 		valenceBits = 0;
 		valenceType = 0;
-		gridPoints[r][c].extendFlag = 0;
+		W.points[r][c].extendFlag = 0;
 
 		int boundaryCount = 0;
 		boundaryCount += (r == 0); // top row?
@@ -533,10 +704,10 @@ void TMesh::updateMeshInfo()
 				valenceBits |= b;
 			}
 		};
-		addBit(VALENCE_BIT_UP, r > 0 and gridV[r-1][c].on); // up
-		addBit(VALENCE_BIT_DOWN, r < rows and gridV[r][c].on); // down
-		addBit(VALENCE_BIT_LEFT, c > 0 and gridH[r][c-1].on); // left
-		addBit(VALENCE_BIT_RIGHT, c < cols and gridH[r][c].on); // right
+		addBit(VALENCE_BIT_UP, r > 0 and W.V[r-1][c].on); // up
+		addBit(VALENCE_BIT_DOWN, r < rows and W.V[r][c].on); // down
+		addBit(VALENCE_BIT_LEFT, c > 0 and W.H[r][c-1].on); // left
+		addBit(VALENCE_BIT_RIGHT, c < cols and W.H[r][c].on); // right
 
 		if(boundaryCount == 0) // inner vertices
 		{
@@ -572,19 +743,20 @@ void TMesh::updateMeshInfo()
 	// Validate edges (only if vertices are fine)
 	FOR(r,0,rows + 1) FOR(c,0,cols)
 	{
-		gridH[r][c].valid = true;
-		gridH[r][c].extend = false;
+		W.H[r][c].valid = true;
+		W.H[r][c].extend = false;
 	}
 	FOR(r,0,rows) FOR(c,0,cols + 1)
 	{
-		gridV[r][c].valid = true;
-		gridV[r][c].extend = false;
+		W.V[r][c].valid = true;
+		W.V[r][c].extend = false;
 	}
 
 	// Don't check if doing curves (1D)
 	if(rows * cols == 0)
 	{
 		isAD = isAS = true;
+		finish();
 		return;
 	}
 
@@ -604,16 +776,16 @@ void TMesh::updateMeshInfo()
 			int lastC = -1;
 			FOR(c,0,cols + 1)
 			{
-				int type = gridPoints[r][c].valenceType;
+				int type = W.points[r][c].valenceType;
 				if(type <= 0) // only consider full (4), T (3), horizontal (2), or vertical (2)
 					continue;
 				if(lastC >= 0)
 				{
-					if(type == 3 and gridPoints[r][lastC].valenceType == 3 and
-						not gridH[r][c-1].on)
+					if(type == 3 and W.points[r][lastC].valenceType == 3 and
+						not W.H[r][c-1].on)
 					{
 						FOR(i,lastC,c)
-							gridH[r][i].valid = false;
+							W.H[r][i].valid = false;
 						isAD = false;
 					}
 				}
@@ -627,16 +799,16 @@ void TMesh::updateMeshInfo()
 			int lastR = -1;
 			FOR(r,0,rows + 1)
 			{
-				int type = gridPoints[r][c].valenceType;
+				int type = W.points[r][c].valenceType;
 				if(type <= 0) // only consider full (4), T (3), horizontal (2), or vertical (2)
 					continue;
 				if(lastR >= 0)
 				{
-					if(type == 3 and gridPoints[lastR][c].valenceType == 3 and
-						not gridV[r-1][c].on)
+					if(type == 3 and W.points[lastR][c].valenceType == 3 and
+						not W.V[r-1][c].on)
 					{
 						FOR(i,lastR,r)
-							gridV[i][c].valid = false;
+							W.V[i][c].valid = false;
 						isAD = false;
 					}
 				}
@@ -645,6 +817,14 @@ void TMesh::updateMeshInfo()
 		}
 	}
 
+	// Other degrees than (3,3): only tensor-product grids, which are always AS and DS
+	if(not isCubic())
+	{
+		isAS = isDS = isAD and isFullGrid();
+		finish();
+		return;
+	}
+
 	// Check whether the mesh is AS (must also be AD)
 	if(not isAD)
 		isAS = false;
@@ -653,16 +833,15 @@ void TMesh::updateMeshInfo()
 		isAS = true; // may turn out to be false after checking
 
 		// Compute vertical index vectors (full)
-		knotsCols.resize(cols+1);
+		KC.resize(cols+1);
 		FOR(c,0,cols+1)
 		{
-			VI& K {knotsCols[c]};
-			K.clear();
+			VI& K {KC[c]};
 			K.push_back(-1);
 			FOR(r,0,rows+1)
 			{
-				int& v {gridPoints[r][c].vId};
-				if(isSkipped(r, c, true)) v = -1;
+				int& v {W.points[r][c].vId};
+				if(isSkipped(W.points[r][c], true)) v = -1;
 				else
 				{
 					v = SZ(K);
@@ -673,16 +852,15 @@ void TMesh::updateMeshInfo()
 		}
 
 		// Compute horizontal index vectors (full)
-		knotsRows.resize(rows+1);
+		KR.resize(rows+1);
 		FOR(r,0,rows+1)
 		{
-			VI& K {knotsRows[r]};
-			K.clear();
+			VI& K {KR[r]};
 			K.push_back(-1);
 			FOR(c,0,cols+1)
 			{
-				int& h {gridPoints[r][c].hId};
-				if(isSkipped(r, c, false)) h = -1;
+				int& h {W.points[r][c].hId};
+				if(isSkipped(W.points[r][c], false)) h = -1;
 				else
 				{
 					h = SZ(K);
@@ -692,13 +870,13 @@ void TMesh::updateMeshInfo()
 			K.push_back(cols + 1);
 		}
 
-		blendDir.assign(rows, VI(cols, DIR_BOTH));
+		dir.assign(rows, VI(cols, DIR_BOTH));
 
 		// Compute T-junction extensions (ignore boundary vertices)
 		FOR(r,1,rows) FOR(c,1,cols)
 		{
 			// Only consider T-junctions
-			if(gridPoints[r][c].valenceType != 3)
+			if(W.points[r][c].valenceType != 3)
 				continue;
 
 			// range for marking blending direction
@@ -706,22 +884,22 @@ void TMesh::updateMeshInfo()
 			int maxRes {-1};
 			int isVert {-1};
 
-			switch(gridPoints[r][c].valenceBits)
+			switch(W.points[r][c].valenceBits)
 			{
 			case 0b1110: // T
-				markExtension(r, c, -1, 0, true, minRes, maxRes);
+				markExtension(W, r, c, -1, 0, true, minRes, maxRes);
 				isVert = 1;
 				break;
 			case 0b1101: // _|_
-				markExtension(r, c, 1, 0, true, minRes, maxRes);
+				markExtension(W, r, c, 1, 0, true, minRes, maxRes);
 				isVert = 1;
 				break;
 			case 0b1011: // |-
-				markExtension(r, c, 0, -1, false, minRes, maxRes);
+				markExtension(W, r, c, 0, -1, false, minRes, maxRes);
 				isVert = 0;
 				break;
 			case 0b0111: // -|
-				markExtension(r, c, 0, 1, false, minRes, maxRes);
+				markExtension(W, r, c, 0, 1, false, minRes, maxRes);
 				isVert = 0;
 				break;
 			}
@@ -730,26 +908,26 @@ void TMesh::updateMeshInfo()
 			{
 				if(isVert)
 				{
-					const int h {gridPoints[r][c].hId};
+					const int h {W.points[r][c].hId};
 					assert(h != -1);
-					int c_min {knotsRows[r][max(h-2, 1)]}; // 1 to exclude the left frame region
-					int c_max {knotsRows[r][min(h+2, SZ(knotsRows[r])-2)]}; // -2 to exclude the right frame region
+					int c_min {KR[r][max(h-2, 1)]}; // 1 to exclude the left frame region
+					int c_max {KR[r][min(h+2, SZ(KR[r])-2)]}; // -2 to exclude the right frame region
 					FOR(r,minRes,maxRes+1) FOR(c,c_min,c_max)
 					{
 						// Mark unit element "cannot blend first by column"
-						blendDir[r][c] &= ~DIR_COLUMN;
+						dir[r][c] &= ~DIR_COLUMN;
 					}
 				}
 				else
 				{
-					const int v {gridPoints[r][c].vId};
+					const int v {W.points[r][c].vId};
 					assert(v != -1);
-					int r_min {knotsCols[c][max(v-2, 1)]}; // 1 to exclude the top frame region
-					int r_max {knotsCols[c][min(v+2, SZ(knotsCols[c])-2)]}; // -2 to exclude the bottom frame region
+					int r_min {KC[c][max(v-2, 1)]}; // 1 to exclude the top frame region
+					int r_max {KC[c][min(v+2, SZ(KC[c])-2)]}; // -2 to exclude the bottom frame region
 					FOR(r,r_min,r_max) FOR(c,minRes,maxRes+1)
 					{
 						// Mark unit element "cannot blend first by row"
-						blendDir[r][c] &= ~DIR_ROW;
+						dir[r][c] &= ~DIR_ROW;
 					}
 				}
 			}
@@ -757,7 +935,7 @@ void TMesh::updateMeshInfo()
 
 		FOR(r,0,rows + 1) FOR(c,0,cols + 1)
 		{
-			if(gridPoints[r][c].extendFlag == EXTENSION_BOTH)
+			if(W.points[r][c].extendFlag == EXTENSION_BOTH)
 			{
 				isAS = false;
 				goto doneAS;
@@ -776,7 +954,7 @@ void TMesh::updateMeshInfo()
 
 		FOR(r,0,rows) FOR(c,0,cols)
 		{
-			if(blendDir[r][c] == 0)
+			if(dir[r][c] == 0)
 			{
 				isDS = false;
 				goto doneDS;
@@ -785,6 +963,49 @@ void TMesh::updateMeshInfo()
 
 		doneDS:;
 	}
+
+	finish();
+}
+
+// Tabulate the local knot vectors of all anchors (needs the index vectors of a cubic AS mesh)
+void TMesh::updateLocalKnots()
+{
+	if(rows * cols == 0 or not isAS or not isCubic())
+	{
+		localKnots = NULL;
+		return;
+	}
+
+	const TMesh &T {*this}; // read without copying shared rows
+	auto L = make_shared<TLocalKnots>();
+	L->stride = cols + 1;
+	FOR(k,0,6)
+	{
+		L->H[k].resize((rows + 1) * L->stride);
+		L->V[k].resize((rows + 1) * L->stride);
+	}
+
+	FOR(r,0,rows+1)
+	{
+		const VI &row {T.knotsRows[r]};
+		FOR(c,0,cols+1)
+		{
+			const int h {T.gridPoints[r][c].hId};
+			FOR(dh,-2,4)
+				L->H[dh + 2][r * L->stride + c] = knotsH[row[max(0, min(SZ(row) - 1, h + dh))] + 1];
+		}
+	}
+	FOR(c,0,cols+1)
+	{
+		const VI &col {T.knotsCols[c]};
+		FOR(r,0,rows+1)
+		{
+			const int v {T.gridPoints[r][c].vId};
+			FOR(dv,-2,4)
+				L->V[dv + 2][r * L->stride + c] = knotsV[col[max(0, min(SZ(col) - 1, v + dv))] + 1];
+		}
+	}
+	localKnots = move(L);
 }
 
 void TMesh::getTiledFloorRange(const int r, const int c, int& r_min, int& r_max, int& c_min, int& c_max) const
@@ -1033,23 +1254,25 @@ void TMesh::test1(int ur, int uc,
 
 
 // Initialize mesh information for the scene
-void TMeshScene::setup(TMesh *tmesh)
+void TMeshScene::setup(TMesh *tmesh, const TMesh *previous)
 {
 	mesh = tmesh;
-	updateScene();
+	updateScene(previous);
 }
 
 // Update the grid spheres for the scene, including coordinates
-void TMeshScene::updateScene()
+void TMeshScene::updateScene(const TMesh *previous)
 {
+	const TMesh &T {*mesh}; // read only, so that no shared rows are copied
+
 	// Update dynamic objects in 'gridSpheres' if dimensions change
-	if(rows != mesh->rows or cols != mesh->cols)
+	if(rows != T.rows or cols != T.cols)
 	{
 		freeGridSpheres();
 		sphereIndices.clear();
 
-		rows = mesh->rows;
-		cols = mesh->cols;
+		rows = T.rows;
+		cols = T.cols;
 		gridSpheres.assign(rows + 1, vector<PSO>(cols + 1, PSO(NULL, NULL)));
 
 		FOR(r,0,rows + 1) FOR(c,0,cols + 1)
@@ -1060,8 +1283,16 @@ void TMeshScene::updateScene()
 		}
 	}
 
-	FOR(r,0,rows + 1) FOR(c,0,cols + 1)
-		gridSpheres[r][c].first->setCenter(mesh->gridPoints[r][c].position);
+	if(previous and (previous->rows != rows or previous->cols != cols))
+		previous = NULL;
+	FOR(r,0,rows + 1)
+	{
+		if(previous and T.gridPoints.sharesRow(previous->gridPoints, r))
+			continue;
+		FOR(c,0,cols + 1)
+			gridSpheres[r][c].first->setCenter(T.gridPoints[r][c].position);
+	}
+	++version;
 }
 
 void TMeshScene::updateSphere(Sphere *sphere)
@@ -1071,7 +1302,9 @@ void TMeshScene::updateSphere(Sphere *sphere)
 	{
 		int r = it->second.first;
 		int c = it->second.second;
-		mesh->gridPoints[r][c].position = sphere->getCenter();
+		mesh->beginEdit();
+		mesh->setPosition(r, c, sphere->getCenter());
+		mesh->commitEdit();
 	}
 }
 
@@ -1129,48 +1362,69 @@ static Light* createLight(int id) {
 	return ret;
 }
 
-static TriMesh* createTriMesh(const VVP3 &S)
+// Compute the normals of a triangle mesh and keep it in compact form
+template <class Real>
+static CompactMesh* compactMesh(DynArray<Vector<Real, 4>>* pts, TriIndArray* inds, Arena* arena = NULL)
+{
+	TriMeshT<Real> mesh(pts,inds); // deletes the arrays
+	mesh.setVNormals(RenderingUtils::perVertexNormals(pts,inds,arena));
+	return new CompactMesh(mesh);
+}
+
+/*
+ * Arena room for the points, vertex normals and triangles of a mesh, and
+ * the face normals and adjacency of RenderingUtils::perVertexNormals()
+ */
+template <class Real>
+static size_t meshBytes(int nverts, int ntris)
+{
+	return size_t(nverts) * (2 * sizeof(Vector<Real, 4>) + sizeof(int)) +
+		size_t(ntris) * (sizeof(TriInd) + sizeof(Vector<Real, 4>) + 3 * sizeof(int)) + 512;
+}
+
+/*
+ * Two triangles per cell of an (R+1) x (C+1) grid of vertices, numbered row
+ * by row from id0. The cells go row by row in bands of columns narrow enough
+ * for the vertices of a row to still be in the vertex cache on the next one
+ * (see MeshOptimizer), so that most vertices are transformed once. The first
+ * row of a band loads two rows of vertices, which must fit: with wider rows,
+ * a FIFO cache misses every vertex twice from then on.
+ */
+static void addGridTriangles(TriIndArray* inds, int id0, int R, int C)
+{
+	const int band {MeshOptimizer::CACHE_SIZE / 2 - 2};
+	for(int c0 = 0; c0 < C; c0 += band) FOR(r,0,R) FOR(c,c0,min(C,c0+band))
+	{
+		// wz : w  | wz
+		// xy : xy |  y
+		int w = id0 + r * (C + 1) + c;
+		int x = w + C + 1;
+		int y = x + 1;
+		int z = w + 1;
+		inds->add(TriInd(w,x,y));
+		inds->add(TriInd(w,y,z));
+	}
+}
+
+static CompactMesh* createTriMesh(const VVP3 &S)
 {
-	int nverts, ntris;
 	Pt3Array* pts = new Pt3Array();
 	TriIndArray* inds = new TriIndArray();
 
 	int R = SZ(S) - 1;
 	int C = SZ(S[0]) - 1;
 
-	nverts = (R + 1) * (C + 1);
-	pts->recap(nverts);
-
-	vector<VI> ID(R+1,VI(C+1));
-	int id0 = 0;
+	pts->recap((R + 1) * (C + 1));
 	FOR(r,0,R+1) FOR(c,0,C+1)
-	{
-		ID[r][c] = id0++;
 		pts->add(S[r][c]);
-	}
 
-	ntris = R * C * 2;
-	inds->recap(ntris);
-	FOR(r,0,R) FOR(c,0,C)
-	{
-		int w = ID[r][c];
-		int x = ID[r+1][c];
-		int y = ID[r+1][c+1];
-		int z = ID[r][c+1];
-		inds->add(TriInd(w,x,y));
-		inds->add(TriInd(w,y,z));
-	}
-
-	TriMesh* ret = new TriMesh(pts,inds);
+	inds->recap(R * C * 2);
+	addGridTriangles(inds, 0, R, C);
 
-	// compute the normals
-	ret->setFNormals(RenderingUtils::perFaceNormals(pts,inds));
-	ret->setVNormals(RenderingUtils::perVertexNormals(pts,inds));
-
-	return ret;
+	return compactMesh(pts, inds);
 }
 
-static TriMesh* createTriMesh2(const vector<VVP3>& Ss)
+static CompactMesh* createTriMesh2(const vector<VVP3>& Ss)
 {
 	// Count the number of vertices and triangles to allocate just enough memory
 	int nverts {0};
@@ -1198,32 +1452,69 @@ static TriMesh* createTriMesh2(const vector<VVP3>& Ss)
 		int R {SZ(S) - 1};
 		int C {SZ(S[0]) - 1};
 
-		vector<VI> ID(R+1,VI(C+1));
 		FOR(r,0,R+1) FOR(c,0,C+1)
-		{
-			ID[r][c] = id0++;
 			pts->add(S[r][c]);
-		}
+		addGridTriangles(inds, id0, R, C);
+		id0 += (R + 1) * (C + 1);
+	}
+
+	return compactMesh(pts, inds);
+}
 
-		FOR(r,0,R) FOR(c,0,C)
+/*
+ * Sample every element on an N x N grid straight into the mesh arrays, in
+ * Real precision. The arrays of the pass share one arena sized up front, so
+ * the number of allocations does not depend on the number of elements.
+ * Returns NULL if cancelled on the way.
+ */
+template <class Real>
+static CompactMesh* createUniformMesh(const TMeshEvaluator &eval, int N, const function<bool ()> &cancelled)
+{
+	const int nelems {eval.numElements()};
+	const int nverts {nelems * (N + 1) * (N + 1)};
+	const int ntris {nelems * N * N * 2};
+	Arena arena {meshBytes<Real>(nverts, ntris)};
+
+	auto* pts = new typename TriMeshT<Real>::PointArray(&arena);
+	TriIndArray* inds = new TriIndArray(&arena);
+	pts->resizeUninit(nverts);
+	inds->recap(ntris);
+	FOR(e,0,nelems)
+	{
+		if(cancelled and cancelled())
 		{
-			// wz : w  | wz
-			// xy : xy |  y
-			int w = ID[r][c];
-			int x = ID[r+1][c];
-			int y = ID[r+1][c+1];
-			int z = ID[r][c+1];
-			inds->add(TriInd(w,x,y));
-			inds->add(TriInd(w,y,z));
+			delete pts;
+			delete inds;
+			return NULL;
 		}
+		const int id0 {e * (N + 1) * (N + 1)};
+		eval.tessellateElement(e, N, N, pts->getData() + id0);
+		addGridTriangles(inds, id0, N, N);
 	}
 
-	TriMesh* ret = new TriMesh(pts,inds);
-	// compute the normals
-	ret->setFNormals(RenderingUtils::perFaceNormals(pts,inds));
-	ret->setVNormals(RenderingUtils::perVertexNormals(pts,inds));
+	return compactMesh(pts, inds, &arena);
+}
 
-	return ret;
+/*
+ * Points are rounded to Real (computed in double). The triangles are
+ * reordered for the vertex cache and the vertices renumbered in order of use.
+ */
+template <class Real>
+static CompactMesh* createTriMesh3(const VP3& points, const vector<TriInd>& tris)
+{
+	Arena arena {meshBytes<Real>(SZ(points), SZ(tris))};
+	auto* pts = new typename TriMeshT<Real>::PointArray(&arena);
+	TriIndArray* inds = new TriIndArray(&arena);
+	pts->recap(SZ(points));
+	inds->recap(SZ(tris));
+	for(const TriInd& tri: tris) inds->add(tri);
+
+	vector<int> order;
+	MeshOptimizer::optimizeVertexCache(inds->getData(), inds->size(), SZ(points));
+	MeshOptimizer::optimizeVertexFetch(inds->getData(), inds->size(), SZ(points), order);
+	for(int i: order) pts->add(Vector<Real, 4>(points[i]));
+
+	return compactMesh(pts, inds, &arena);
 }
 
 TriMeshScene::TriMeshScene()
@@ -1231,6 +1522,9 @@ TriMeshScene::TriMeshScene()
 	_mat = NULL;
 	_mesh = NULL;
 	useCurve = false;
+	_version = 0;
+	_hasView = false;
+	_viewW = _viewH = 0;
 
 	this->setMaterial(createMaterial());
 	Color amb(0.1,0.1,0.1,1);
@@ -1248,133 +1542,87 @@ void TriMeshScene::setCurve(vector<pair<Pt3, int>> points)
 {
 	curvePoints = move(points);
 	useCurve = true;
+	++_version;
 }
 
-void TriMeshScene::setMesh(const VVP3& S)
+void TriMeshScene::setCurve(TCurveEvaluatorPtr eval)
 {
-	_mesh = createTriMesh(S);
-	useCurve = false;
+	// Keep the samples and the arc-length table if the curve hasn't changed
+	if(useCurve and _curve and _curve->sameCurve(*eval))
+		return;
+
+	SceneBuffer buf;
+	buildCurve(move(eval), buf);
+	swapBuffer(buf);
 }
 
-void TriMeshScene::setMesh2(const vector<VVP3>& S)
+TCurveArcLengthPtr TriMeshScene::getArcLength()
 {
-	_mesh = createTriMesh2(S);
-	useCurve = false;
+	if(not _arcLength and _curve and useCurve)
+		_arcLength = make_shared<const TCurveArcLength>(_curve);
+	return _arcLength;
 }
 
-
-
-
-
-
-
-// Describes each node in the pyramid in the de Boor Algorithm
-struct PyramidNode
+Vec3f CompactMesh::getFNormal(int j) const
 {
-	// Denote parameters t_l or t_r along the up-left (t-t_l) or up-right (t_r-t) arrow
-	double knotL, knotR;
-	// Coordinates of the point
-	Pt3 point;
-};
+	// As in RenderingUtils::perFaceNormals()
+	const Pt3f a {getPoint(getInd(j, 0))}, b {getPoint(getInd(j, 1))}, c {getPoint(getInd(j, 2))};
+	Vec3f n = cross(b-a, c-a);
+	n.normalize();
+	return n;
+}
 
-static Pt3 localDeBoor(int deg, double t, vector<PyramidNode> layer)
+void CompactMesh::getStrips(vector<unsigned>& strip, unsigned restart) const
 {
-	// Run the local de Boor Algorithm on this segment
-	for(int i = deg; i >= 1; --i)
-	{
-		// At this moment, we have i+1 points in the vector 'layer'.
+	vector<TriInd> tris(numTriangles());
+	FOR(j,0,SZ(tris)) FOR(k,0,3)
+		tris[j][k] = getInd(j, k);
+	MeshOptimizer::makeStrips(tris.data(), SZ(tris), restart, strip);
+}
 
-		// Compute the new points
-		vector<PyramidNode> newLayer(i);
-		for(int j = 0; j < i; ++j)
-		{
-			double ta = layer[j + 1].knotL;
-			double tb = layer[j].knotR;
-			newLayer[j].knotL = ta;
-			newLayer[j].knotR = tb;
-			newLayer[j].point =
-				layer[j].point * ((tb-t) / (tb-ta)) +
-				layer[j+1].point * ((t-ta) / (tb-ta));
-		}
-		// Replace the current layer (i+1 points) with the new layer (i points)
-		layer = move(newLayer);
-	}
+size_t CompactMesh::getBytes() const
+{
+	return _pts.size() * sizeof(_pts[0]) + _vnormals.size() * sizeof(unsigned) +
+		_inds16.size() * sizeof(unsigned short) + _inds32.size() * sizeof(unsigned);
+}
 
-	return move(layer[0].point); // the top of the de Boor pyramid
+void TriMeshScene::replaceMesh(CompactMesh *mesh)
+{
+	delete _mesh;
+	_mesh = mesh;
+	useCurve = false;
+	++_version;
 }
 
-// Update the index 'p' to cover the appropriate knot values given a particular parameter t
-static void updateSegmentIndex(int &p, int n, double t, const vector<double> &knots)
+void TriMeshScene::setMesh(const VVP3& S)
 {
-	while(p + 1 < n and (t > knots[p + 1] + 1e-9 or abs(knots[p] - knots[p + 1]) < 1e-9))
-		++p;
+	replaceMesh(createTriMesh(S));
 }
 
-// Retrieve parameters t_l or t_r along the up-left (t-t_l) or up-right (t_r-t) arrow
-static void populateKnotLR(PyramidNode &node, int p, int deg, const vector<double> &knots)
+void TriMeshScene::setMesh2(const vector<VVP3>& S)
 {
-	int idL = p - deg;
-	int idR = p + 1;
-	node.knotL = (idL < 0) ? 0 : knots[idL];
-	node.knotR = (idR >= SZ(knots)) ? 0 : knots[idR];
+	replaceMesh(createTriMesh2(S));
 }
 
-void TriMeshScene::setScene(const TMesh* T)
+void TriMeshScene::setMesh3(const VP3& points, const vector<TriInd>& tris)
 {
-	if(T->rows * T->cols == 0)
-	{
-		vector<pair<Pt3, int>> P;
+	if(_tessOptions.singlePrecision)
+		replaceMesh(createTriMesh3<float>(points, tris));
+	else
+		replaceMesh(createTriMesh3<double>(points, tris));
+}
 
-		if(T->rows == 0) // 1 x (C+1) grid
-		{
-			if(1) // Interpolate points
-			{
-				const int N = 1000; // fixed for now
-				P.resize(N + 1);
-				double t0 = T->knotsH[T->degH - 1];
-				double t1 = T->knotsH[T->cols];
-				double dt = (t1 - t0) / N;
-
-				int p = T->degH - 1;
-				for(int i = 0; i <= N; ++i)
-				{
-					double t = t0 + dt * i;
 
-					// Find the correct segment for this parameter t
-					updateSegmentIndex(p, T->cols, t, T->knotsH);
 
-					// Collect the initial control points for this segment
-					vector<PyramidNode> baseLayer(T->degH + 1);
-					for(int j = 0; j <= T->degH; ++j)
-					{
-						int r1 = 0;
-						int c1 = j + p - T->degH + 1;
-						baseLayer[j].point = T->gridPoints[r1][c1].position;
-						populateKnotLR(baseLayer[j], j + p, T->degH, T->knotsH);
-					}
 
-					/*
-					* Evaluate at t - run the local de Boor Algorithm on this segment
-					* Also store the index p for segment verification (for visualization)
-					*/
-					P[i] = {localDeBoor(T->degH, t, move(baseLayer)), p};
-				}
-			}
-			if(0) // Use the control points directly
-			{
-				P.resize(T->cols + 1);
-				for(int i = 0; i <= T->cols; ++i)
-					P[i] = {T->gridPoints[0][i].position, 0};
-			}
-		}
-		else // (R+1) x 1 grid
-		{
-			// TODO: make this the same as 1 x (C+1) grid (though, it's redundant)
-			P.resize(T->rows + 1);
-			for(int i = 0; i <= T->rows; ++i)
-				P[i] = {T->gridPoints[i][0].position, 0};
-		}
-		setCurve(P);
+
+
+
+void TriMeshScene::setScene(const TMesh* T)
+{
+	if(T->rows * T->cols == 0)
+	{
+		setCurve(make_shared<const TCurveEvaluator>(*T));
 	}
 	else if(false) // B-spline
 	{
@@ -1422,7 +1670,7 @@ void TriMeshScene::setScene(const TMesh* T)
 		auto B_s = [&](double s, vector<double>& knots)
 		{
 			assert(SZ(knots) == 5);
-			static double dp[4][4];
+			double dp[4][4];
 			FOR(j,0,4) dp[0][j] = (knots[j] <= s and s < knots[j+1]) ? 1.0 : 0.0;
 			FOR(i,1,4) FOR(j,0,4-i)
 			{
@@ -1528,226 +1776,206 @@ void TriMeshScene::setScene(const TMesh* T)
 
 		setMesh(S);
 	}
+	else
+		setSurface(make_shared<const TMeshEvaluator>(*T, _evaluator.get()));
+}
 
-	if(true) // de Boor
-	{
-		vector<VVP3> Ss;
-		VVP3 S;
-		FOR(ur,1,T->rows-1) FOR(uc,1,T->cols-1)
-		{
-			// Skip dead areas
-			if(T->blendDir[ur][uc] == DIR_NEITHER) continue;
-
-			const double s0 {T->knotsV[ur + 1]};
-			const double s1 {T->knotsV[ur + 2]};
-			const double t0 {T->knotsH[uc + 1]};
-			const double t1 {T->knotsH[uc + 2]};
-
-			// Skip unit elements with zero-area parameter space (s,t)
-			if(s0 + 1e-9 > s1 or t0 + 1e-9 > t1) continue;
-
-			bool ready {false};
-			auto populateS = [&](double r_margin, double c_margin)
-			{
-				S.assign(2, VP3(2));
-				int r {ur};
-				int c {uc};
-				FOR(i,0,2) FOR(j,0,2)
-				{
-					Pt3 p(0,0,0,0);
-					FOR(a,0,2) FOR(b,0,2)
-					{
-						double wa {(a == i) ? 1 - r_margin : r_margin};
-						double wb {(b == j) ? 1 - c_margin : c_margin};
-						p += T->gridPoints[r+a][c+b].position * wa * wb;
-					}
-					S[i][j] = p;
-				}
-
-				ready = true;
-			};
-
-			// Retrieve the 16 blending points for the unit element (ur, uc)
-			bool row_n_4, col_n_4;
-			vector<pair<int,int>> blendP;
-
-			if(false)
-			{
-				//T->get16Points(ur, uc, blendP, row_n_4, col_n_4);
-				T->get16PointsFast(ur, uc, blendP, row_n_4, col_n_4);
-			}
-			else // Testing...
-			{
-				vector<pair<int,int>> blendP2, missing, extra;
-				T->test1(ur, uc, blendP, blendP2, missing, extra, row_n_4, col_n_4);
-				if(blendP != blendP2)
-				{
-					cout << "\n\nBAD\n";
-					cout << "missing : ";
-					for(auto p: missing) cout << p._1 << ' ' << p._2 << "    ";
-					cout << endl;
-					cout << "extra   : ";
-					for(auto p: extra) cout << p._1 << ' ' << p._2 << "    ";
-					cout << endl;
-				}
-			}
+void TriMeshScene::setSurface(TMeshEvaluatorPtr eval)
+{
+	SceneBuffer buf;
+	// Cached element grids stay valid as long as the evaluator does (the
+	// cache may be in use by a view update on the rebuild worker meanwhile)
+	if(eval == _evaluator)
+		buf.tessCache = _tessCache;
+	buildSurface(move(eval), getBuildSettings(), buf);
+	swapBuffer(buf);
+}
 
-			const int RN {20};
-			const int CN {20};
-			const double ds {(s1 - s0) / RN};
-			const double dt {(t1 - t0) / CN};
+SceneBuildSettings TriMeshScene::getBuildSettings() const
+{
+	SceneBuildSettings settings;
+	settings.options = _tessOptions;
+	settings.hasView = _hasView;
+	if(_hasView)
+	{
+		settings.modelview = _viewModelview;
+		settings.proj = _viewProj;
+		settings.width = _viewW;
+		settings.height = _viewH;
+	}
+	return settings;
+}
 
-			auto populateKnotsH = [&](vector<double>& K, pair<int,int> p_r_c1)
-			{
-				K.clear();
-				K.reserve(6);
-				int p_r, p_c;
-				tie(p_r, p_c) = p_r_c1;
-				const int h {T->gridPoints[p_r][p_c].hId};
-				FOR(dh,-2,4)
-				{
-					const int hh {max(0, min(SZ(T->knotsRows[p_r]) - 1, h + dh))};
-					K.emplace_back(T->knotsH[T->knotsRows[p_r][hh] + 1]);
-				}
-			};
+bool TriMeshScene::build(const TMesh &T, const SceneBuildSettings &settings, SceneBuffer &buf,
+	const function<bool ()> &cancelled)
+{
+	if(T.rows * T.cols == 0)
+	{
+		buf.evaluator = NULL;
+		buildCurve(make_shared<const TCurveEvaluator>(T), buf);
+		return true;
+	}
 
-			auto populateKnotsV = [&](vector<double>& K, pair<int,int> p_r1_c)
-			{
-				K.clear();
-				K.reserve(6);
-				int p_r, p_c;
-				tie(p_r, p_c) = p_r1_c;
-				const int v {T->gridPoints[p_r][p_c].vId};
-				FOR(dv,-2,4)
-				{
-					const int vv {max(0, min(SZ(T->knotsCols[p_c]) - 1, v + dv))};
-					K.emplace_back(T->knotsV[T->knotsCols[p_c][vv] + 1]);
-				}
-			};
+	// After knot or position edits, the anchors of the previous surface still hold
+	TMeshEvaluatorPtr eval {make_shared<const TMeshEvaluator>(T, buf.evaluator.get())};
+	if(cancelled and cancelled())
+		return false;
+	return buildSurface(move(eval), settings, buf, cancelled);
+}
 
-			if(row_n_4) // can process row-then-column
-			{
-				// blendP: row-major by default
+void TriMeshScene::buildCurve(TCurveEvaluatorPtr eval, SceneBuffer &buf)
+{
+	buf.isCurve = true;
+	buf.curve = move(eval);
+	// Sample the curve adaptively, span by span
+	buf.curvePoints.clear();
+	buf.curve->sample(buf.curvePoints);
+}
 
-				// Restrict the vertices to within the active region
-				for(auto& p: blendP) T->cap(p._1, p._2);
+// The stitched mesh of a tessellator, in the precision of the options
+static void setBufferMesh(SceneBuffer &buf, const TessellationOptions &opt, const VP3 &points, const vector<TriInd> &tris)
+{
+	if(opt.singlePrecision)
+		buf.mesh = createTriMesh3<float>(points, tris);
+	else
+		buf.mesh = createTriMesh3<double>(points, tris);
+}
 
-				// Horizontal knot vectors, one per row
-				vector<double> kH[4];
-				FOR(r,0,4) populateKnotsH(kH[r], blendP[r * 4 + 1]); // P[0..3][1]
+bool TriMeshScene::buildSurface(TMeshEvaluatorPtr eval, const SceneBuildSettings &settings, SceneBuffer &buf,
+	const function<bool ()> &cancelled)
+{
+	auto stop = [&]() { return cancelled and cancelled(); };
+	const TessellationOptions &opt {settings.options};
 
-				// Vertical knot vector
-				vector<double> kV;
-				populateKnotsV(kV, blendP[5]); // P[1][1]
+	buf.isCurve = false;
+	buf.evaluator = move(eval);
+	buf.tessellator = NULL;
+	buf.lodDensity.clear();
 
-				S.assign(RN + 1, VP3(CN + 1));
-				FOR(ri,0,RN+1) FOR(ci,0,CN+1)
-				{
-					const double s {s0 + ds * ri};
-					const double t {t0 + dt * ci};
+	if(opt.screenSpace)
+	{
+		buf.tessellator = make_shared<const TMeshTessellator>(buf.evaluator, opt);
+		if(not buf.tessCache)
+			buf.tessCache = make_shared<TessellationCache>(buf.evaluator->numElements());
+		if(settings.hasView)
+		{
+			if(stop())
+				return false;
+			VP3 points;
+			vector<TriInd> tris;
+			buf.tessellator->screenDensities(settings.modelview, settings.proj,
+				settings.width, settings.height, buf.lodDensity);
+			if(stop() or not buf.tessellator->tessellate(buf.lodDensity, points, tris, buf.tessCache.get(), cancelled))
+				return false;
+			setBufferMesh(buf, opt, points, tris);
+			return true;
+		}
+		// No camera yet: use world-space densities until the first view
+	}
 
-					// Collect the initial control points for this vertical segment
-					vector<PyramidNode> pointsV(4);
-					for(int r = 0; r <= 3; ++r)
-					{
-						// Collect the initial control points for each horizontal segment
-						vector<PyramidNode> pointsH(4);
-						for(int c = 0; c <= 3; ++c)
-						{
-							int bp_r, bp_c;
-							tie(bp_r, bp_c) = blendP[r * 4 + c];
-
-							pointsH[c].point = T->gridPoints[bp_r][bp_c].position;
-							populateKnotLR(pointsH[c], c + 2, 3, kH[r]);
-						}
-
-						// Run the local de Boor algorithm on this horizontal segment
-						populateKnotLR(pointsV[r], r + 2, 3, kV);
-						pointsV[r].point = localDeBoor(3, t, move(pointsH));
-					}
+	if(opt.adaptive or opt.screenSpace)
+	{
+		if(stop())
+			return false;
+		// Error-driven densities, stitched into one watertight mesh
+		VP3 points;
+		vector<TriInd> tris;
+		if(not TMeshTessellator(buf.evaluator, opt).tessellate(points, tris, cancelled))
+			return false;
+		setBufferMesh(buf, opt, points, tris);
+		return true;
+	}
 
-					// Run the local de Boor Algorithm on this vertical segment
-					S[ri][ci] = localDeBoor(3, s, move(pointsV));
-				}
+	// Sampled in single precision or in double
+	const int N {opt.uniformN};
+	CompactMesh *mesh {opt.singlePrecision ? createUniformMesh<float>(*buf.evaluator, N, cancelled) :
+		createUniformMesh<double>(*buf.evaluator, N, cancelled)};
+	if(mesh == NULL)
+		return false;
+	buf.mesh = mesh;
+	return true;
+}
 
-				ready = true;
-			}
-			else if(col_n_4) // can process column-then-row
-			{
-				// Make blendP column-major
-				sort(begin(blendP), end(blendP), [&](const auto& p, const auto& q)
-				{
-					if(p._2 != q._2) return p._2 < q._2;
-					else return p._1 < q._1;
-				});
-				// Restrict the vertices to within the active region
-				for(auto& p: blendP) T->cap(p._1, p._2);
-				// Make blendP row-major again (now sorted)
-				FOR(i,0,4) FOR(j,0,i) swap(blendP[i*4 + j], blendP[j*4 + i]);
-
-				auto findVEdge = [&](int& c, int dc)
-				{
-					do
-					{
-						c += dc;
-						if(c < 0)
-						{
-							c = 0;
-							break;
-						}
-						else if(c > T->cols)
-						{
-							c = T->cols;
-							break;
-						}
-					}
-					while(not T->gridV[ur][c].on);
-				};
+void TriMeshScene::swapBuffer(SceneBuffer &buf)
+{
+	if(buf.viewUpdate)
+	{
+		// Too late if the surface was replaced meanwhile
+		if(useCurve or buf.tessellator != _tessellator)
+			return;
+		if(_pendingDensity == buf.lodDensity)
+			_pendingDensity.clear();
+		swap(_lodDensity, buf.lodDensity);
+		swap(_mesh, buf.mesh);
+		++_version;
+		return;
+	}
 
-				// Vertical knot vectors, one per column
-				vector<double> kV[4];
-				FOR(c,0,4) populateKnotsV(kV[c], blendP[4 + c]); // P[1][0..3]
+	if(buf.isCurve)
+	{
+		// Keep the samples and the arc-length table if the curve hasn't changed
+		if(useCurve and _curve and _curve->sameCurve(*buf.curve))
+			return;
+		swap(_curve, buf.curve);
+		swap(curvePoints, buf.curvePoints);
+		_arcLength = NULL;
+		useCurve = true;
+		++_version;
+		return;
+	}
 
-				// Horizontal knot vector
-				vector<double> kH;
-				populateKnotsH(kH, blendP[5]); // P[1][1]
+	swap(_evaluator, buf.evaluator);
+	swap(_tessellator, buf.tessellator);
+	swap(_tessCache, buf.tessCache);
+	swap(_lodDensity, buf.lodDensity);
+	swap(_mesh, buf.mesh);
+	_pendingDensity.clear();
+	useCurve = false;
+	++_version;
+}
 
-				S.assign(RN + 1, VP3(CN + 1));
-				FOR(ri,0,RN+1) FOR(ci,0,CN+1)
-				{
-					const double s {s0 + ds * ri};
-					const double t {t0 + dt * ci};
+void TriMeshScene::setTessellation(const TessellationOptions &opt, bool retessellate)
+{
+	_tessOptions = opt;
+	if(retessellate and _evaluator and not useCurve)
+		setSurface(_evaluator);
+}
 
-					// Collect the initial control points for this horizontal segment
-					vector<PyramidNode> pointsH(4);
-					for(int c = 0; c <= 3; ++c)
-					{
-						// Collect the initial control points for each vertical segment
-						vector<PyramidNode> pointsV(4);
-						for(int r = 0; r <= 3; ++r)
-						{
-							int bp_r, bp_c;
-							tie(bp_r, bp_c) = blendP[r * 4 + c];
-
-							pointsV[r].point = T->gridPoints[bp_r][bp_c].position;
-							populateKnotLR(pointsV[r], r + 2, 3, kV[c]);
-						}
-
-						// Run the local de Boor algorithm on this vertical segment
-						populateKnotLR(pointsH[c], c + 2, 3, kH);
-						pointsH[c].point = localDeBoor(3, s, move(pointsV));
-					}
+void TriMeshScene::setView(const Mat4 &modelview, const Mat4 &proj, int width, int height)
+{
+	_hasView = true;
+	_viewModelview = modelview;
+	_viewProj = proj;
+	_viewW = width;
+	_viewH = height;
+}
 
-					// Run the local de Boor Algorithm on this horizontal segment
-					S[ri][ci] = localDeBoor(3, t, move(pointsH));
-				}
+bool TriMeshScene::updateView(SceneBuffer &buf)
+{
+	if(not _hasView or not _tessellator or useCurve)
+		return false;
 
-				ready = true;
-			}
+	// Only re-stitch when some element changes its level
+	vector<pair<int,int>> density;
+	_tessellator->screenDensities(_viewModelview, _viewProj, _viewW, _viewH, density);
+	if(density == _lodDensity or density == _pendingDensity)
+		return false;
 
-			if(ready) Ss.emplace_back(move(S));
-		}
+	_pendingDensity = density;
+	buf.viewUpdate = true;
+	buf.evaluator = _evaluator;
+	buf.tessellator = _tessellator;
+	buf.tessCache = _tessCache; // shared with any build of the same surface (see TessellationCache)
+	buf.lodDensity = move(density);
+	return true;
+}
 
-		setMesh2(Ss);
-	}
+bool TriMeshScene::buildView(SceneBuffer &buf, const TessellationOptions &opt, const function<bool ()> &cancelled)
+{
+	VP3 points;
+	vector<TriInd> tris;
+	if(not buf.tessellator->tessellate(buf.lodDensity, points, tris, buf.tessCache.get(), cancelled))
+		return false;
+	setBufferMesh(buf, opt, points, tris);
+	return true;
 }
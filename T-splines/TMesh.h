@@ -4,11 +4,50 @@
 #include "Rendering/Operator.h"
 #include "Rendering/RenderingPrimitives.h"
 #include "Rendering/ShadeAndShapes.h"
+#include "Common/SharedRows.h"
 
+#include <memory>
 #include <mutex>
 
 typedef pair<Sphere*,Operator*> PSO;
 
+class TMesh;
+class TMeshEvaluator;
+class TCurveEvaluator;
+class TCurveArcLength;
+class TMeshTessellator;
+class TessellationCache;
+typedef shared_ptr<const TMesh> TMeshSnapshot;
+typedef shared_ptr<const TMeshEvaluator> TMeshEvaluatorPtr;
+typedef shared_ptr<const TCurveEvaluator> TCurveEvaluatorPtr;
+typedef shared_ptr<const TCurveArcLength> TCurveArcLengthPtr;
+typedef shared_ptr<const TMeshTessellator> TMeshTessellatorPtr;
+
+// Highest degree of surfaces along either direction (curves may use any degree)
+const int MAX_SURFACE_DEGREE = 5;
+
+// How a surface is turned into triangles
+struct TessellationOptions
+{
+	bool adaptive {false}; // error-driven densities instead of a fixed grid
+	int uniformN {20}; // samples per element side when not adaptive
+	double chordTol {1e-3}; // max chordal deviation, relative to the surface size
+	double normalTol {10}; // max normal deviation between samples (degrees)
+	int maxN {64}; // upper bound on the samples per element side
+	bool screenSpace {false}; // follow the camera (chordal tolerance in pixels)
+	double pixelTol {0.5}; // max chordal deviation on screen (pixels)
+	bool singlePrecision {false}; // sample and compute normals in float32 (see TMeshEvaluator::getFloatError())
+};
+
+// What building a curve or surface depends on besides the mesh
+struct SceneBuildSettings
+{
+	TessellationOptions options;
+	bool hasView {false}; // whether a camera is known (view-dependent mode)
+	Mat4 modelview, proj;
+	int width {0}, height {0};
+};
+
 enum ValenceType {VALENCE_INVALID = -1};
 enum ValenceBits
 {
@@ -28,6 +67,15 @@ enum ExtensionBits
 	// Denotes an intersection of V-H T-junction extensions
 	EXTENSION_BOTH = 3
 };
+// What an edit transaction changed
+enum EditBits
+{
+	EDIT_NONE = 0,
+	EDIT_TOPOLOGY = 1,
+	EDIT_KNOTS = 2,
+	EDIT_GEOMETRY = 4,
+	EDIT_ALL = 7
+};
 enum DirectionBits
 {
 	DIR_NEITHER = 0,
@@ -74,31 +122,63 @@ struct EdgeInfo
 	}
 };
 
+/*
+ * Local knot vectors (6 knots) of every anchor along its row (H) and its
+ * column (V), for analysis-suitable meshes. Stored as one flat array per
+ * knot: H[k][r * stride + c] is knot k of anchor (r, c). Immutable once
+ * built, so snapshots and evaluators share it.
+ */
+struct TLocalKnots
+{
+	int stride; // cols + 1
+	vector<double> H[6], V[6];
+
+	void get(bool vertical, int r, int c, double K[6]) const
+	{
+		const vector<double> *src {vertical ? V : H};
+		const int i {r * stride + c};
+		FOR(k,0,6) K[k] = src[k][i];
+	}
+};
+typedef shared_ptr<const TLocalKnots> TLocalKnotsPtr;
+
 class TMesh
 {
 public:
-	mutex lock; // For allowing only one thread to access the mesh at a time
+	mutex lock; // For allowing only one thread to modify the mesh at a time
 	int rows, cols;
 	int degH, degV; // Horizontal: for each row, Vertical: for each column
 	vector<double> knotsH, knotsV;
-	vector<vector<EdgeInfo>> gridH, gridV;
-	vector<vector<VertexInfo>> gridPoints; // explicit and implicit vertex info
+	// Grids are stored by rows that are shared with snapshots until written
+	SharedRows<EdgeInfo> gridH, gridV;
+	SharedRows<VertexInfo> gridPoints; // explicit and implicit vertex info
 
 	// Implicit (computed) information
 	bool validVertices; // true if all active vertices have valences 3-4 or 2 (straight)
 	bool isAD; // admissible?
 	bool isAS; // analysis-suitable?
 	bool isDS; // de Boor-suitable?
-	vector<VI> knotsCols, knotsRows; // indices, per column/row, discarding unused ones
-	vector<VI> blendDir; // for each unit element whether it is allowed to blend
-	                     // by row (0-bit) and/or column (1-bit) first
+	SharedRows<int> knotsCols, knotsRows; // indices, per column/row, discarding unused ones
+	SharedRows<int> blendDir; // for each unit element whether it is allowed to blend
+	                          // by row (0-bit) and/or column (1-bit) first
+	TLocalKnotsPtr localKnots; // per anchor, refreshed with the topology and the knots (AS only)
+
+	// Generation counters, bumped on every change of the respective data, so that
+	// views can tell whether anything they depend on changed since they last looked.
+	// Topology generations are also unique across meshes (see newTopologyGen()), so
+	// that an evaluator of one mesh is never taken for one of another
+	unsigned topologyGen; // edges (renewed by updateMeshInfo())
+	unsigned knotsGen; // knot values
+	unsigned geometryGen; // control point positions
 
 	TMesh(int r, int c, int dv, int dh, bool autoFill = true);
+	// Copies everything but the lock (a snapshot for other threads)
+	TMesh(const TMesh &T);
 	~TMesh();
 
 	void assign(TMesh &tmesh);
 	bool meshFromFile(const string &path);
-	bool meshToFile(const string &path);
+	bool meshToFile(const string &path) const;
 	bool useVertex(int r, int c) const;
 	void cap(int& r, int& c) const;
 
@@ -107,6 +187,37 @@ public:
 	static bool checkDuplicateAtKnotEnds(const vector<double> &knots, int n, int deg);
 
 	void updateMeshInfo();
+	// T-junctions are only supported for degrees (3,3); other degrees need a full grid
+	bool isCubic() const { return degH == 3 and degV == 3; }
+	// Whether all edges are on (a tensor-product B-spline)
+	bool isFullGrid() const;
+	// Sum of the generation counters: changes whenever any of them does
+	unsigned generation() const { return topologyGen + knotsGen + geometryGen; }
+	/*
+	 * Readers (other threads, long operations) work on immutable snapshots.
+	 * A writer publishes the mesh after each change, holding 'lock'; this
+	 * costs O(rows) as unchanged rows are shared. updateMeshInfo() publishes.
+	 */
+	void publish();
+	// The last published state (never waits for writers)
+	TMeshSnapshot snapshot() const { return atomic_load(&published); }
+	/*
+	 * Return to a published state, derived info included (no updateMeshInfo()),
+	 * and republish it. O(rows): rows are shared with 'S' again.
+	 */
+	void restore(const TMeshSnapshot &S);
+
+	/*
+	 * Edit transactions. beginEdit() takes 'lock'; the edits made until
+	 * commitEdit() only note what they change. commitEdit() then recomputes
+	 * the derived info once (for topology changes), publishes, releases the
+	 * lock and returns the EditBits that changed.
+	 */
+	void beginEdit();
+	void setEdge(bool vertical, int r, int c, bool on); // gridV if vertical, else gridH
+	void setKnots(bool vertical, vector<double> knots); // knotsV if vertical, else knotsH
+	void setPosition(int r, int c, const Pt3 &p);
+	int commitEdit();
 	void getTiledFloorRange(const int r, const int c, int& r_min, int& r_max, int& c_min, int& c_max) const;
 	void get16Points(int ur, int uc, vector<pair<int,int>>& blendP, bool& row_n_4, bool& col_n_4) const;
 	void get16PointsFast(int ur, int uc, vector<pair<int,int>>& blendP, bool& row_n_4, bool& col_n_4) const;
@@ -116,9 +227,22 @@ public:
 		bool& row_n_4, bool& col_n_4) const;
 
 private:
-	void markExtension(int r0, int c0, int dr, int dc, bool isVert, int& minRes, int& maxRes);
+	TMeshSnapshot published;
+	int editChanges; // EditBits of the open transaction
+
+	// Plain copies of the grids, in which updateMeshInfo() derives the implicit info
+	struct GridWork
+	{
+		vector<vector<VertexInfo>> points;
+		vector<vector<EdgeInfo>> H, V;
+	};
+
+	void updateLocalKnots();
+	void markExtension(GridWork &W, int r0, int c0, int dr, int dc, bool isVert, int& minRes, int& maxRes) const;
 	bool isWithinGrid(int r, int c) const;
-	bool isSkipped(int r, int c, bool isVert) const;
+	static bool isSkipped(const VertexInfo &v, bool isVert);
+	// A topology generation no mesh has had yet
+	static unsigned newTopologyGen();
 };
 
 class TMeshScene : public SceneInfo
@@ -126,46 +250,59 @@ class TMeshScene : public SceneInfo
 protected:
 	TMesh *mesh;
 	map<Sphere*, pair<int, int>> sphereIndices;
+	unsigned version; // bumped whenever the spheres or links may have changed
 
 public:
 	const double radius = 0.05;
 	int rows, cols; // internal dimensions for updating 'gridSpheres'
 	vector<vector<PSO>> gridSpheres;
 
-	TMeshScene() : mesh(NULL), rows(0), cols(0) {}
+	TMeshScene() : mesh(NULL), version(0), rows(0), cols(0) {}
 	~TMeshScene() { freeGridSpheres(); }
 
-	void setup(TMesh *tmesh);
-	void updateScene();
+	void setup(TMesh *tmesh, const TMesh *previous = NULL);
+	// Rows of control points shared with 'previous' (same dimensions) are skipped
+	void updateScene(const TMesh *previous = NULL);
 	void updateSphere(Sphere *sphere);
 	void freeGridSpheres();
+	// A sphere was moved directly (e.g. dragged by its operator)
+	void sphereMoved() { ++version; }
+	unsigned getVersion() const { return version; }
 
 	bool useSphere(int r, int c) const;
-	const vector<vector<EdgeInfo>> &getGridH() const { return mesh->gridH; }
-	const vector<vector<EdgeInfo>> &getGridV() const { return mesh->gridV; }
+	const SharedRows<EdgeInfo> &getGridH() const { return mesh->gridH; }
+	const SharedRows<EdgeInfo> &getGridV() const { return mesh->gridV; }
 };
 
-class TriMesh {
+// A triangle mesh with double (TriMesh) or float (TriMeshF) points and normals,
+// built by the tessellation and kept as a CompactMesh
+template <class Real>
+class TriMeshT {
+public:
+	typedef DynArray<Vector<Real, 4>> PointArray;
+
 protected:
-	Pt3Array* _pts;
-	Vec3Array* _vnormals;
-	Vec3Array* _fnormals;
+	PointArray* _pts;
+	PointArray* _vnormals;
+	PointArray* _fnormals;
 	TriIndArray* _tinds; // mesh is made of triangles
 public:
 
-	TriMesh() {
+	TriMeshT() {
 		_pts = NULL;
 		_vnormals = NULL;
 		_fnormals = NULL;
 		_tinds = NULL;
 	}
-	TriMesh(Pt3Array* pts, TriIndArray* inds) {
+	TriMeshT(PointArray* pts, TriIndArray* inds) {
 		_pts = pts;
+		_vnormals = NULL;
+		_fnormals = NULL;
 		_tinds = inds;
 	}
-	~TriMesh() { del(); }
+	~TriMeshT() { del(); }
 
-	void setPoints(Pt3Array* p) {
+	void setPoints(PointArray* p) {
 		_pts = p;
 	}
 
@@ -173,18 +310,18 @@ public:
 		_tinds = ti;
 	}
 
-	void setVNormals(Vec3Array* n) {
+	void setVNormals(PointArray* n) {
 		_vnormals = n;
 	}
 
-	void setFNormals(Vec3Array* n) {
+	void setFNormals(PointArray* n) {
 		_fnormals = n;
 	}
 
-	Pt3Array* getPoints() const { return _pts; }
+	PointArray* getPoints() const { return _pts; }
 	TriIndArray* getInds() const { return _tinds; }
-	Vec3Array* getVNormals() const { return _vnormals; }
-	Vec3Array* getFNormals() const { return _fnormals; }
+	PointArray* getVNormals() const { return _vnormals; }
+	PointArray* getFNormals() const { return _fnormals; }
 
 	// use these delete functions carefully
 	void del() {
@@ -220,17 +357,119 @@ protected:
 	}
 };
 
+typedef TriMeshT<double> TriMesh;
+typedef TriMeshT<float> TriMeshF;
+
+/*
+ * The triangle mesh of a surface as drawn: float3 positions, octahedral
+ * vertex normals (32 bits, see RenderingUtils::encodeNormal()) and 16-bit
+ * indices when there are at most 65536 vertices, 32-bit otherwise. Face
+ * normals are recomputed from the positions. About a quarter of the memory
+ * of a TriMesh.
+ */
+class CompactMesh {
+public:
+	template <class Real>
+	explicit CompactMesh(const TriMeshT<Real> &mesh);
+
+	int numVertices() const { return SZ(_pts); }
+	int numTriangles() const { return int((_shortInds ? _inds16.size() : _inds32.size()) / 3); }
+	Pt3f getPoint(int i) const { return Pt3f(_pts[i][0], _pts[i][1], _pts[i][2]); }
+	Vec3f getVNormal(int i) const { return RenderingUtils::decodeNormal(_vnormals[i]); }
+	Vec3f getFNormal(int j) const;
+	// Vertex k of triangle j
+	int getInd(int j, int k) const { return _shortInds ? _inds16[3 * j + k] : int(_inds32[3 * j + k]); }
+	bool hasShortInds() const { return _shortInds; }
+	// The triangles as strips separated by 'restart' (see MeshOptimizer::makeStrips())
+	void getStrips(vector<unsigned>& strip, unsigned restart = 0xFFFFFFFF) const;
+	size_t getBytes() const;
+
+private:
+	vector<array<float, 3>> _pts;
+	vector<unsigned> _vnormals;
+	bool _shortInds;
+	vector<unsigned short> _inds16;
+	vector<unsigned> _inds32;
+};
+
+template <class Real>
+CompactMesh::CompactMesh(const TriMeshT<Real> &mesh)
+{
+	const auto &pts = *mesh.getPoints();
+	const auto &vnorms = *mesh.getVNormals();
+	const TriIndArray &inds = *mesh.getInds();
+
+	_pts.resize(pts.size());
+	_vnormals.resize(pts.size());
+	FOR(i,0,pts.size())
+	{
+		const auto p = pts.get(i), n = vnorms.get(i);
+		_pts[i] = {{float(p[0]), float(p[1]), float(p[2])}};
+		_vnormals[i] = RenderingUtils::encodeNormal(n[0], n[1], n[2]);
+	}
+
+	_shortInds = pts.size() <= 65536;
+	if(_shortInds) _inds16.resize(3 * inds.size());
+	else _inds32.resize(3 * inds.size());
+	FOR(j,0,inds.size())
+	{
+		const TriInd tri {inds.get(j)};
+		FOR(k,0,3)
+		{
+			if(_shortInds) _inds16[3 * j + k] = (unsigned short) tri[k];
+			else _inds32[3 * j + k] = unsigned(tri[k]);
+		}
+	}
+}
+
+/*
+ * A curve or surface built away from the scene (the back buffer of a rebuild),
+ * swapped in by TriMeshScene::swapBuffer(). Owns its mesh.
+ */
+struct SceneBuffer
+{
+	TMeshSnapshot source; // the mesh state it was built from, if known
+	bool isCurve {false};
+	bool viewUpdate {false}; // the shown surface re-stitched for a new view (see TriMeshScene::updateView())
+	TCurveEvaluatorPtr curve;
+	vector<pair<Pt3, int>> curvePoints;
+	TMeshEvaluatorPtr evaluator;
+	TMeshTessellatorPtr tessellator;
+	shared_ptr<TessellationCache> tessCache;
+	vector<pair<int,int>> lodDensity;
+	CompactMesh *mesh {NULL};
+
+	SceneBuffer() {}
+	SceneBuffer(const SceneBuffer &) = delete;
+	SceneBuffer &operator=(const SceneBuffer &) = delete;
+	~SceneBuffer() { delete mesh; }
+};
+
 class TriMeshScene : public SceneInfo {
 protected:
 	Material* _mat;
 	vector<Light*> _lights;
-	TriMesh* _mesh;
+	CompactMesh* _mesh;
+	TMeshEvaluatorPtr _evaluator; // compiled from the mesh of the last surface
+	TCurveEvaluatorPtr _curve; // compiled from the mesh of the last curve
+	TCurveArcLengthPtr _arcLength; // built on demand for '_curve'
+	TessellationOptions _tessOptions;
+	TMeshTessellatorPtr _tessellator; // for the view-dependent mode
+	shared_ptr<TessellationCache> _tessCache; // element grids of '_evaluator'
+	vector<pair<int,int>> _lodDensity; // densities of the current mesh
+	vector<pair<int,int>> _pendingDensity; // densities of the view update being built, if any
+	bool _hasView;
+	Mat4 _viewModelview, _viewProj;
+	int _viewW, _viewH;
 	vector<pair<Pt3, int>> curvePoints;
 	bool useCurve;
+	unsigned _version; // bumped whenever the curve or mesh is replaced
 
 	void setCurve(vector<pair<Pt3, int>> points);
 	void setMesh(const VVP3& S);
 	void setMesh2(const vector<VVP3>& S);
+	void setMesh3(const VP3& points, const vector<TriInd>& tris);
+	void replaceMesh(CompactMesh *mesh);
 
 public:
 	TriMeshScene();
@@ -238,23 +477,58 @@ public:
 	~TriMeshScene() {
 		for(Light *l: _lights) delete l;
 		_lights.clear();
-		if(_mesh)
-		{
-			_mesh->del(); // have to be sure that no one shares this data
-			delete _mesh;
-		}
+		delete _mesh;
 		if(_mat) delete _mat;
 	}
 
 	// Set data (curve/surface) for drawing
 	void setScene(const TMesh *T);
+	// Set the curve/surface from an evaluator (no access to the mesh is needed)
+	void setCurve(TCurveEvaluatorPtr eval);
+	void setSurface(TMeshEvaluatorPtr eval);
+	// Change how surfaces are tessellated (and re-tessellate the current surface)
+	void setTessellation(const TessellationOptions &opt, bool retessellate = true);
+	const TessellationOptions &getTessellation() const { return _tessOptions; }
+	SceneBuildSettings getBuildSettings() const;
+
+	/*
+	 * Build the curve or surface of a mesh into 'buf' without touching any
+	 * scene, so that it may run on another thread. 'cancelled' is polled on
+	 * the way; the build is abandoned (returning false) once it returns true.
+	 * If 'buf.evaluator' is set (to an earlier surface of the same mesh), its
+	 * topology-derived tables are reused when the edges are unchanged.
+	 */
+	static bool build(const TMesh &T, const SceneBuildSettings &settings, SceneBuffer &buf,
+		const function<bool ()> &cancelled = nullptr);
+	static void buildCurve(TCurveEvaluatorPtr eval, SceneBuffer &buf);
+	// Reuses the element grids of 'buf.tessCache' if set (same evaluator only)
+	static bool buildSurface(TMeshEvaluatorPtr eval, const SceneBuildSettings &settings, SceneBuffer &buf,
+		const function<bool ()> &cancelled = nullptr);
+	// Show a built curve or surface; 'buf' receives the previous one
+	void swapBuffer(SceneBuffer &buf);
+	// Follow the camera (for the view-dependent mode)
+	void setView(const Mat4 &modelview, const Mat4 &proj, int width, int height);
+	/*
+	 * Whether the surface should be re-stitched for the current view: its
+	 * densities differ from those shown and from those already being built.
+	 * If so, 'buf' is set up for buildView() (and swapBuffer() afterwards).
+	 */
+	bool updateView(SceneBuffer &buf);
+	// Re-stitch the surface of 'buf' at 'buf.lodDensity'; may run on another thread
+	static bool buildView(SceneBuffer &buf, const TessellationOptions &opt,
+		const function<bool ()> &cancelled = nullptr);
 
 	void setMaterial(Material* m) { _mat = m; }
 	void addLight(Light* l) { _lights.push_back(l); }
 
 	bool willDrawCurve() const { return useCurve; }
+	unsigned getVersion() const { return _version; }
 	vector<pair<Pt3, int>> &getCurve() { return curvePoints; }
-	TriMesh* getMesh() { return _mesh; }
+	CompactMesh* getMesh() { return _mesh; }
+	TMeshEvaluatorPtr getEvaluator() const { return _evaluator; }
+	TCurveEvaluatorPtr getCurveEvaluator() const { return _curve; }
+	// Arc-length table of the current curve (built once per curve), or NULL
+	TCurveArcLengthPtr getArcLength();
 	Material* getMaterial() { return _mat; }
 	int getNumLights() { return SZ(_lights); }
 	Light* getLight(int i) { return _lights[i]; }
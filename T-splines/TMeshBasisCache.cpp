@@ -0,0 +1,198 @@
+#include "TMeshBasisCache.h"
+
+bool BasisTableCache::Key::operator==(const Key &other) const
+{
+	if(rowFirst != other.rowFirst or degIn != other.degIn or degOut != other.degOut or
+		RN != other.RN or CN != other.CN or numKnots != other.numKnots)
+		return false;
+	FOR(k,0,numKnots) if(knots[k] != other.knots[k])
+		return false;
+	return true;
+}
+
+size_t BasisTableCache::KeyHash::operator()(const Key &key) const
+{
+	// FNV-1a over the fields
+	unsigned long long h {1469598103934665603ULL};
+	auto add = [&](unsigned long long v) { h = (h ^ v) * 1099511628211ULL; };
+	add(key.rowFirst);
+	add(key.degIn);
+	add(key.degOut);
+	add(key.RN);
+	add(key.CN);
+	FOR(k,0,key.numKnots) add((unsigned long long) key.knots[k]);
+	return size_t(h);
+}
+
+BasisTableCache::BasisTableCache(size_t m)
+	: maxBytes(m), bytes(0), hits(0), misses(0)
+{
+}
+
+BasisTableCache &BasisTableCache::shared()
+{
+	static BasisTableCache cache;
+	return cache;
+}
+
+BasisTablePtr BasisTableCache::get(const TMeshEvaluator &eval, const TElement &E, int RN, int CN)
+{
+	// Normalize the knots to the element's span (the inner direction is t if row-first)
+	const double inLo {E.rowFirst ? E.t0 : E.s0};
+	const double inLen {E.rowFirst ? E.t1 - E.t0 : E.s1 - E.s0};
+	const double outLo {E.rowFirst ? E.s0 : E.t0};
+	const double outLen {E.rowFirst ? E.s1 - E.s0 : E.t1 - E.t0};
+
+	Key key;
+	key.rowFirst = E.rowFirst;
+	key.degIn = eval.innerDegree(E);
+	key.degOut = eval.outerDegree(E);
+	key.RN = RN;
+	key.CN = CN;
+	const int nIn {2 * key.degIn}, nOut {2 * key.degOut};
+	key.numKnots = (key.degOut + 1) * nIn + nOut;
+
+	double knots[MAX_KNOTS];
+	FOR(i,0,key.degOut+1)
+	{
+		const double *K {eval.getKnotsInner(E, i)};
+		FOR(k,0,nIn) knots[i * nIn + k] = (K[k] - inLo) / inLen;
+	}
+	const double *K {eval.getKnotsOuter(E)};
+	FOR(k,0,nOut) knots[(key.degOut + 1) * nIn + k] = (K[k] - outLo) / outLen;
+	FOR(k,0,key.numKnots) key.knots[k] = llround(knots[k] * 1e9);
+
+	{
+		lock_guard<mutex> guard(lock);
+		auto it = tables.find(key);
+		if(it != end(tables))
+		{
+			++hits;
+			order.splice(begin(order), order, it->second._2);
+			return it->second._1;
+		}
+		++misses;
+	}
+
+	// Compute without the lock; another thread may add the same table meanwhile
+	BasisTablePtr table {compute(key, knots)};
+
+	lock_guard<mutex> guard(lock);
+	auto it = tables.find(key);
+	if(it != end(tables))
+		return it->second._1;
+	order.push_front(key);
+	tables[key] = {table, begin(order)};
+	bytes += table->size() * sizeof(double);
+
+	// Evict the least recently used tables (always keeping the new one)
+	while(bytes > maxBytes and SZ(order) > 1)
+	{
+		auto last = tables.find(order.back());
+		bytes -= last->second._1->size() * sizeof(double);
+		tables.erase(last);
+		order.pop_back();
+	}
+	return table;
+}
+
+// The DEG+1 basis values at u: de Boor is linear in the points, so run it on unit points
+template <int DEG>
+static void basisValues(const double *K, double u, double *b)
+{
+	if(isUniform(K, 2 * DEG))
+	{
+		uniformBasis(DEG, K, u, b);
+		return;
+	}
+	FOR(j,0,DEG+1)
+	{
+		// One point at a time (a Pt3 holds 4 values, not up to 6)
+		PyramidNode layer[DEG + 1];
+		FOR(i,0,DEG+1)
+		{
+			populateKnotLR(layer[i], i + DEG - 1, DEG, K, 2 * DEG);
+			layer[i].point = Pt3(i == j, 0, 0, 0);
+		}
+		b[j] = localDeBoor(DEG, u, layer)[0];
+	}
+}
+
+template <int DI, int DO>
+BasisTablePtr BasisTableCache::computeDegrees(const Key &key, const double *knots)
+{
+	const int RN {key.RN}, CN {key.CN};
+	const int nIn {key.rowFirst ? CN : RN}; // samples along the inner direction
+	const int nOut {key.rowFirst ? RN : CN}; // and along the outer one (the span is [0, 1] in both)
+	const double *outer {knots + (DO + 1) * 2 * DI};
+
+	vector<double> bIn((DO + 1) * (nIn + 1) * (DI + 1)), bOut((nOut + 1) * (DO + 1));
+	FOR(i,0,DO+1) FOR(k,0,nIn+1)
+		basisValues<DI>(knots + i * 2 * DI, double(k) / nIn, &bIn[(i * (nIn + 1) + k) * (DI + 1)]);
+	FOR(k,0,nOut+1)
+		basisValues<DO>(outer, double(k) / nOut, &bOut[k * (DO + 1)]);
+
+	// Row-major points: degH + 1 per row
+	const int N {(DI + 1) * (DO + 1)};
+	const int W {key.rowFirst ? DI + 1 : DO + 1};
+	auto table = make_shared<vector<double>>((RN + 1) * (CN + 1) * N);
+	FOR(ri,0,RN+1) FOR(ci,0,CN+1)
+	{
+		const int in {key.rowFirst ? ci : ri};
+		const int out {key.rowFirst ? ri : ci};
+		double *w {&(*table)[(ri * (CN + 1) + ci) * N]};
+		FOR(i,0,DO+1) FOR(j,0,DI+1)
+		{
+			// Inner curve i blends its points j; the outer pass blends the curves
+			const double v {bOut[out * (DO + 1) + i] * bIn[(i * (nIn + 1) + in) * (DI + 1) + j]};
+			if(key.rowFirst) w[i * W + j] = v;
+			else w[j * W + i] = v;
+		}
+	}
+	return table;
+}
+
+BasisTablePtr BasisTableCache::compute(const Key &key, const double *knots)
+{
+	static_assert(MAX_SURFACE_DEGREE == 5, "extend the kernel table");
+	typedef BasisTablePtr (*ComputeFn)(const Key &key, const double *knots);
+#define COMPUTE_ROW(d) {computeDegrees<d,1>, computeDegrees<d,2>, computeDegrees<d,3>, \
+	computeDegrees<d,4>, computeDegrees<d,5>}
+	static const ComputeFn COMPUTE_FNS[5][5] {
+		COMPUTE_ROW(1), COMPUTE_ROW(2), COMPUTE_ROW(3), COMPUTE_ROW(4), COMPUTE_ROW(5)
+	};
+#undef COMPUTE_ROW
+	return COMPUTE_FNS[key.degIn - 1][key.degOut - 1](key, knots);
+}
+
+void BasisTableCache::clear()
+{
+	lock_guard<mutex> guard(lock);
+	tables.clear();
+	order.clear();
+	bytes = 0;
+}
+
+unsigned long long BasisTableCache::getHits() const
+{
+	lock_guard<mutex> guard(lock);
+	return hits;
+}
+
+unsigned long long BasisTableCache::getMisses() const
+{
+	lock_guard<mutex> guard(lock);
+	return misses;
+}
+
+int BasisTableCache::size() const
+{
+	lock_guard<mutex> guard(lock);
+	return SZ(tables);
+}
+
+size_t BasisTableCache::getBytes() const
+{
+	lock_guard<mutex> guard(lock);
+	return bytes;
+}
@@ -0,0 +1,75 @@
+#ifndef T_MESH_BASIS_CACHE_H
+#define T_MESH_BASIS_CACHE_H
+
+#include "TMeshEvaluator.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// Weights of the N = (degV+1) x (degH+1) control points of an element at each
+// sample of an (RN+1) x (CN+1) grid: weights[(ri * (CN+1) + ci) * N + r * (degH+1) + c]
+typedef shared_ptr<const vector<double>> BasisTablePtr;
+
+/*
+ * Basis weight tables shared between elements (hash-consing).
+ *
+ * The weights at an element's uniform samples only depend on its local
+ * knots up to translation and scaling, which repeat over most of a mesh.
+ * So the knots are normalized to the element's span, and elements with the
+ * same degrees, normalized knots (within 1e-9), blending order and densities
+ * share one table. Sampling then takes an N-weight dot product per sample
+ * instead of a de Boor pyramid.
+ *
+ * The cache is bounded in bytes and evicts the least recently used tables.
+ * It may be used from any thread; tables stay valid after being evicted.
+ */
+class BasisTableCache
+{
+public:
+	explicit BasisTableCache(size_t maxBytes = 64 << 20);
+
+	// Table of element E at densities (RN, CN), computed on a miss
+	BasisTablePtr get(const TMeshEvaluator &eval, const TElement &E, int RN, int CN);
+	void clear();
+
+	unsigned long long getHits() const;
+	unsigned long long getMisses() const;
+	int size() const; // number of tables
+	size_t getBytes() const; // memory held by the tables
+
+	// The cache used by all evaluators
+	static BasisTableCache &shared();
+
+private:
+	// Local knots of an element: (outer degree + 1) inner vectors and the outer one
+	static const int MAX_KNOTS = (MAX_SURFACE_DEGREE + 2) * 2 * MAX_SURFACE_DEGREE;
+
+	struct Key
+	{
+		bool rowFirst;
+		int degIn, degOut;
+		int RN, CN;
+		int numKnots;
+		long long knots[MAX_KNOTS]; // normalized inner and outer knots, in units of 1e-9
+		bool operator==(const Key &other) const;
+	};
+	struct KeyHash
+	{
+		size_t operator()(const Key &key) const;
+	};
+	typedef list<Key> Order; // most recently used first
+
+	mutable mutex lock;
+	size_t maxBytes, bytes;
+	unsigned long long hits, misses;
+	Order order;
+	unordered_map<Key, pair<BasisTablePtr, Order::iterator>, KeyHash> tables;
+
+	static BasisTablePtr compute(const Key &key, const double *knots);
+	// compute() for inner degree DI and outer degree DO, with fixed-size loops
+	template <int DI, int DO>
+	static BasisTablePtr computeDegrees(const Key &key, const double *knots);
+};
+
+#endif // T_MESH_BASIS_CACHE_H
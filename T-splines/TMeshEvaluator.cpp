@@ -0,0 +1,429 @@
+#include "TMeshEvaluator.h"
+#include "TMeshBasisCache.h"
+
+shared_ptr<const vector<TElementAnchors>> TMeshEvaluator::findAnchors(const TMesh &T)
+{
+	auto anchors = make_shared<vector<TElementAnchors>>();
+	vector<pair<int,int>> blendP;
+	FOR(ur,1,T.rows-1) FOR(uc,1,T.cols-1)
+	{
+		// Skip dead areas
+		if(T.blendDir[ur][uc] == DIR_NEITHER) continue;
+
+		// Retrieve the 16 blending points for the unit element (ur, uc)
+		bool row_n_4, col_n_4;
+		T.get16PointsFast(ur, uc, blendP, row_n_4, col_n_4);
+		if(SZ(blendP) != 16 or not (row_n_4 or col_n_4)) continue;
+
+		if(row_n_4) // can process row-then-column
+		{
+			// blendP: row-major by default
+
+			// Restrict the vertices to within the active region
+			for(auto& p: blendP) T.cap(p._1, p._2);
+		}
+		else // can process column-then-row
+		{
+			// Make blendP column-major
+			sort(begin(blendP), end(blendP), [&](const pair<int,int>& p, const pair<int,int>& q)
+			{
+				if(p._2 != q._2) return p._2 < q._2;
+				else return p._1 < q._1;
+			});
+			// Restrict the vertices to within the active region
+			for(auto& p: blendP) T.cap(p._1, p._2);
+			// Make blendP row-major again (now sorted)
+			FOR(i,0,4) FOR(j,0,i) swap(blendP[i*4 + j], blendP[j*4 + i]);
+		}
+
+		TElementAnchors A;
+		A.ur = ur;
+		A.uc = uc;
+		A.rowFirst = row_n_4;
+		FOR(i,0,16) A.points[i] = blendP[i];
+		anchors->push_back(A);
+	}
+	return anchors;
+}
+
+/*
+ * Evaluate an element whose inner curves have degree DI and whose outer pass
+ * has degree DO, with fixed-size loops and pyramids. Its points are in rows
+ * of DI+1 if it blends rows first (ROWS), else in rows of DO+1.
+ */
+template <int DI, int DO, bool ROWS>
+static Pt3 blendElement(const TMeshEvaluator &eval, const TElement &E, double tIn, double tOut)
+{
+	const Pt3 *P {eval.getPoints(E)};
+	const double *KIn {eval.getKnotsInner(E, 0)}; // 2*DI knots per inner curve
+	const double *KOut {KIn + (DO + 1) * 2 * DI};
+	// Point j of inner curve i
+	auto point = [&](int i, int j) -> const Pt3& { return ROWS ? P[i * (DI + 1) + j] : P[j * (DO + 1) + i]; };
+
+	if(E.uniform)
+	{
+		// Fixed basis matrices: blend the inner curves at tIn, then them at tOut
+		double bOut[DO + 1], res[4] {0, 0, 0, 0};
+		uniformBasis(DO, KOut, tOut, bOut);
+		FOR(i,0,DO+1)
+		{
+			double bIn[DI + 1];
+			uniformBasis(DI, KIn + i * 2 * DI, tIn, bIn);
+			FOR(j,0,DI+1)
+			{
+				const Pt3 &Q {point(i, j)};
+				const double w {bOut[i] * bIn[j]};
+				FOR(k,0,4) res[k] += w * Q[k];
+			}
+		}
+		return Pt3(res[0], res[1], res[2], res[3]);
+	}
+
+	PyramidNode outer[DO + 1];
+	FOR(i,0,DO+1)
+	{
+		// Collect the initial control points for this inner segment
+		PyramidNode inner[DI + 1];
+		FOR(j,0,DI+1)
+		{
+			inner[j].point = point(i, j);
+			populateKnotLR(inner[j], j + DI - 1, DI, KIn + i * 2 * DI, 2 * DI);
+		}
+
+		// Run the local de Boor algorithm on this inner segment
+		populateKnotLR(outer[i], i + DO - 1, DO, KOut, 2 * DO);
+		outer[i].point = localDeBoor(DI, tIn, inner);
+	}
+
+	// Run the local de Boor Algorithm on the outer segment
+	return localDeBoor(DO, tOut, outer);
+}
+
+/*
+ * Weigh the N control points of an element for each of 'count' samples.
+ * The sums run in the output precision: float output rounds the points and
+ * weights to float first. Two samples are summed at a time, so that their
+ * chains of additions overlap.
+ */
+template <int N, class Real>
+static void weighSamples(const double *w, const Pt3 *P, int count, Vector<Real, 4> *res)
+{
+	Vector<Real, 4> Q[N];
+	FOR(k,0,N) Q[k] = Vector<Real, 4>(P[k]);
+	int i {0};
+	for(; i + 1 < count; i += 2, w += 2 * N)
+	{
+		Vector<Real, 4> p {Real(w[0]) * Q[0]}, q {Real(w[N]) * Q[0]};
+		FOR(k,1,N)
+		{
+			p += Real(w[k]) * Q[k];
+			q += Real(w[N + k]) * Q[k];
+		}
+		res[i] = p;
+		res[i + 1] = q;
+	}
+	if(i < count)
+	{
+		Vector<Real, 4> p {Real(w[0]) * Q[0]};
+		FOR(k,1,N) p += Real(w[k]) * Q[k];
+		res[i] = p;
+	}
+}
+
+template <int N>
+static void weighPoints(const double *w, const Pt3 *P, int count, Pt3 *res)
+{
+	weighSamples<N>(w, P, count, res);
+}
+
+template <int N>
+static void weighPoints(const double *w, const Pt3 *P, int count, Pt3f *res)
+{
+#ifdef __AVX2__
+	/*
+	 * Two samples per 8-lane register (twice the lanes of a double point),
+	 * with their coordinates interleaved: the points are (x x y y z z h h) and
+	 * the weights of both samples (a b a b ...), one 8-byte broadcast per
+	 * point. Two registers (4 samples) are summed at a time. The sums are the
+	 * same as in weighSamples.
+	 */
+	__m256 Q[N];
+	FOR(k,0,N)
+	{
+		const __m128 q {_mm256_cvtpd_ps(P[k].packed())};
+		Q[k] = _mm256_permutevar8x32_ps(_mm256_castps128_ps256(q), _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3));
+	}
+	const __m256i split {_mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7)};
+
+	// The weights of samples w and w + N as float pairs
+	auto interleave = [](const double *w, float *pairs)
+	{
+		int k {0};
+		for(; k + 3 < N; k += 4)
+		{
+			const __m128 a {_mm256_cvtpd_ps(_mm256_loadu_pd(w + k))};
+			const __m128 b {_mm256_cvtpd_ps(_mm256_loadu_pd(w + N + k))};
+			_mm_storeu_ps(pairs + 2 * k, _mm_unpacklo_ps(a, b));
+			_mm_storeu_ps(pairs + 2 * k + 4, _mm_unpackhi_ps(a, b));
+		}
+		for(; k < N; ++k)
+		{
+			pairs[2 * k] = float(w[k]);
+			pairs[2 * k + 1] = float(w[N + k]);
+		}
+	};
+	auto weight = [](const float *pairs, int k) { return _mm256_castpd_ps(_mm256_broadcast_sd((const double *) (pairs + 2 * k))); };
+
+	float A[2 * N], B[2 * N];
+	int i {0};
+	for(; i + 3 < count; i += 4, w += 4 * N)
+	{
+		interleave(w, A);
+		interleave(w + 2 * N, B);
+		__m256 p {_mm256_mul_ps(weight(A, 0), Q[0])}, q {_mm256_mul_ps(weight(B, 0), Q[0])};
+		FOR(k,1,N)
+		{
+			p = _mm256_add_ps(p, _mm256_mul_ps(weight(A, k), Q[k]));
+			q = _mm256_add_ps(q, _mm256_mul_ps(weight(B, k), Q[k]));
+		}
+		_mm256_storeu_ps(&res[i][0], _mm256_permutevar8x32_ps(p, split));
+		_mm256_storeu_ps(&res[i + 2][0], _mm256_permutevar8x32_ps(q, split));
+	}
+	weighSamples<N>(w, P, count - i, res + i);
+#else
+	weighSamples<N>(w, P, count, res);
+#endif
+}
+
+// Kernel tables for degrees 1 to MAX_SURFACE_DEGREE
+static_assert(MAX_SURFACE_DEGREE == 5, "extend the kernel tables");
+#define BLEND_ROW(d,rows) {blendElement<d,1,rows>, blendElement<d,2,rows>, blendElement<d,3,rows>, \
+	blendElement<d,4,rows>, blendElement<d,5,rows>}
+static const TMeshEvaluator::BlendFn BLEND_FNS[2][5][5] {
+	{BLEND_ROW(1,false), BLEND_ROW(2,false), BLEND_ROW(3,false), BLEND_ROW(4,false), BLEND_ROW(5,false)},
+	{BLEND_ROW(1,true), BLEND_ROW(2,true), BLEND_ROW(3,true), BLEND_ROW(4,true), BLEND_ROW(5,true)}
+};
+#undef BLEND_ROW
+#define WEIGH_ROW(d) {weighPoints<d*2>, weighPoints<d*3>, weighPoints<d*4>, weighPoints<d*5>, weighPoints<d*6>}
+static const TMeshEvaluator::SampleFn<double> SAMPLE_FNS[5][5] {
+	WEIGH_ROW(2), WEIGH_ROW(3), WEIGH_ROW(4), WEIGH_ROW(5), WEIGH_ROW(6)
+};
+static const TMeshEvaluator::SampleFn<float> SAMPLE_FNS_FLOAT[5][5] {
+	WEIGH_ROW(2), WEIGH_ROW(3), WEIGH_ROW(4), WEIGH_ROW(5), WEIGH_ROW(6)
+};
+#undef WEIGH_ROW
+
+TMeshEvaluator::TMeshEvaluator(const TMesh &T, const TMeshEvaluator *previous)
+{
+	rows = T.rows;
+	cols = T.cols;
+	degH = T.degH;
+	degV = T.degV;
+	topologyGen = T.topologyGen;
+	knotsH = T.knotsH;
+	knotsV = T.knotsV;
+	size = 0;
+	floatError = 0;
+	elementIds.assign(rows * cols, -1);
+	blendRows = blendCols = NULL;
+	sample = NULL;
+	sampleFloat = NULL;
+
+	// Only analysis-suitable surfaces have valid blending information
+	if(rows * cols == 0 or not T.isAS)
+		return;
+	assert(1 <= degH and degH <= MAX_SURFACE_DEGREE and 1 <= degV and degV <= MAX_SURFACE_DEGREE);
+
+	// Row-first elements blend rows (degree degH) first; column-first ones columns
+	blendRows = BLEND_FNS[true][degH - 1][degV - 1];
+	blendCols = BLEND_FNS[false][degV - 1][degH - 1];
+	sample = SAMPLE_FNS[degV - 1][degH - 1];
+	sampleFloat = SAMPLE_FNS_FLOAT[degV - 1][degH - 1];
+
+	if(T.isCubic())
+		compileTMesh(T, previous);
+	else
+		compileGrid(T);
+
+	if(points.empty())
+		return;
+	Pt3 lo {points[0]}, hi {lo};
+	double maxCoord {0};
+	for(const Pt3 &p: points) FOR(k,0,4)
+	{
+		lo[k] = min(lo[k], p[k]);
+		hi[k] = max(hi[k], p[k]);
+		maxCoord = max(maxCoord, abs(p[k]));
+	}
+	Vec3 d {hi - lo};
+	d[3] = 0;
+	size = mag(d);
+
+	// Rounding N points, N weights and N products to float, then N-1 sums of
+	// nonnegative terms (the weights sum to 1): at most (N+2) u max|P| to first order
+	const int N {(degV + 1) * (degH + 1)};
+	floatError = (N + 2) * ldexp(1.0, -24) * maxCoord;
+}
+
+void TMeshEvaluator::compileTMesh(const TMesh &T, const TMeshEvaluator *previous)
+{
+	if(not T.localKnots)
+		return;
+	const TLocalKnots &L {*T.localKnots};
+
+	// Topology generations are unique across meshes, so equal ones mean the same edges
+	const bool sameTopology {previous and previous->anchors and previous->topologyGen == topologyGen
+		and previous->rows == rows and previous->cols == cols};
+	anchors = sameTopology ? previous->anchors : findAnchors(T);
+	elements.reserve(anchors->size());
+	points.reserve(anchors->size() * 16);
+	knots.reserve(anchors->size() * 30);
+
+	for(const TElementAnchors &A: *anchors)
+	{
+		TElement E;
+		E.ur = A.ur;
+		E.uc = A.uc;
+		E.s0 = knotsV[A.ur + 1];
+		E.s1 = knotsV[A.ur + 2];
+		E.t0 = knotsH[A.uc + 1];
+		E.t1 = knotsH[A.uc + 2];
+
+		// Skip unit elements with zero-area parameter space (s,t)
+		if(E.s0 + 1e-9 > E.s1 or E.t0 + 1e-9 > E.t1) continue;
+
+		E.rowFirst = A.rowFirst;
+		E.points = SZ(points);
+		E.knots = SZ(knots);
+
+		// Local knot vectors from the mesh's per-anchor table
+		knots.resize(E.knots + 30);
+		double *K {&knots[E.knots]};
+		const pair<int,int> *P {A.points};
+		if(A.rowFirst)
+		{
+			// Horizontal knot vectors, one per row: P[0..3][1]
+			FOR(r,0,4) L.get(false, P[r * 4 + 1]._1, P[r * 4 + 1]._2, K + r * 6);
+			// Vertical knot vector: P[1][1]
+			L.get(true, P[5]._1, P[5]._2, K + 24);
+		}
+		else
+		{
+			// Vertical knot vectors, one per column: P[1][0..3]
+			FOR(c,0,4) L.get(true, P[4 + c]._1, P[4 + c]._2, K + c * 6);
+			// Horizontal knot vector: P[1][1]
+			L.get(false, P[5]._1, P[5]._2, K + 24);
+		}
+
+		E.uniform = true;
+		FOR(i,0,5) E.uniform = E.uniform and isUniform(K + i * 6, 6);
+		FOR(i,0,16)
+			points.push_back(T.gridPoints[P[i]._1][P[i]._2].position);
+
+		elementIds[A.ur * cols + A.uc] = SZ(elements);
+		elements.push_back(E);
+	}
+}
+
+void TMeshEvaluator::compileGrid(const TMesh &T)
+{
+	// A tensor product of the rows' and columns' B-splines: the element of knot
+	// spans (p, q) blends points (p-degV+1 .. p+1) x (q-degH+1 .. q+1)
+	for(int p = degV - 1; p < rows; ++p) for(int q = degH - 1; q < cols; ++q)
+	{
+		TElement E;
+		E.ur = p - spanOffsetV();
+		E.uc = q - spanOffsetH();
+		E.s0 = knotsV[p];
+		E.s1 = knotsV[p + 1];
+		E.t0 = knotsH[q];
+		E.t1 = knotsH[q + 1];
+
+		// Skip unit elements with zero-area parameter space (s,t)
+		if(E.s0 + 1e-9 > E.s1 or E.t0 + 1e-9 > E.t1) continue;
+
+		E.rowFirst = true;
+		E.points = SZ(points);
+		E.knots = SZ(knots);
+
+		// All rows share the horizontal knots; then the vertical ones
+		FOR(i,0,degV+1)
+			knots.insert(end(knots), begin(knotsH) + q - degH + 1, begin(knotsH) + q + degH + 1);
+		knots.insert(end(knots), begin(knotsV) + p - degV + 1, begin(knotsV) + p + degV + 1);
+		E.uniform = isUniform(&knotsH[q - degH + 1], 2 * degH) and isUniform(&knotsV[p - degV + 1], 2 * degV);
+
+		FOR(r,p-degV+1,p+2) FOR(c,q-degH+1,q+2)
+			points.push_back(T.gridPoints[r][c].position);
+
+		elementIds[E.ur * cols + E.uc] = SZ(elements);
+		elements.push_back(E);
+	}
+}
+
+int TMeshEvaluator::findElement(double s, double t) const
+{
+	if(elements.empty())
+		return -1;
+
+	// Element (ur, uc) covers the knot spans [knotsV[p], knotsV[p+1]] x [knotsH[q], knotsH[q+1]]
+	int p = int(upper_bound(begin(knotsV), end(knotsV), s) - begin(knotsV)) - 1;
+	int q = int(upper_bound(begin(knotsH), end(knotsH), t) - begin(knotsH)) - 1;
+	p = max(degV - 1, min(rows - 1, p));
+	q = max(degH - 1, min(cols - 1, q));
+
+	// Step back over empty (repeated-knot) elements at the end of the domain
+	while(p > degV - 1 and knotsV[p] + 1e-9 > knotsV[p + 1]) --p;
+	while(q > degH - 1 and knotsH[q] + 1e-9 > knotsH[q + 1]) --q;
+
+	const int e {elementIds[(p - spanOffsetV()) * cols + q - spanOffsetH()]};
+	if(e < 0) return -1;
+	const TElement &E {elements[e]};
+	if(s < E.s0 - 1e-9 or s > E.s1 + 1e-9 or t < E.t0 - 1e-9 or t > E.t1 + 1e-9)
+		return -1;
+	return e;
+}
+
+bool TMeshEvaluator::evaluate(double s, double t, Pt3 &res) const
+{
+	const int e {findElement(s, t)};
+	if(e < 0) return false;
+	res = evaluateElement(e, s, t);
+	return true;
+}
+
+Pt3 TMeshEvaluator::evaluateElement(int e, double s, double t) const
+{
+	// The inner passes run along t for row-first elements, along s otherwise
+	const TElement &E {elements[e]};
+	return E.rowFirst ? blendRows(*this, E, t, s) : blendCols(*this, E, s, t);
+}
+
+template <class Real>
+void TMeshEvaluator::tessellateElement(int e, int RN, int CN, vector<vector<Vector<Real, 4>>> &S) const
+{
+	const TElement &E {elements[e]};
+	// Elements with the same normalized local knots share their basis weights
+	const BasisTablePtr table {BasisTableCache::shared().get(*this, E, RN, CN)};
+	const int N {(degV + 1) * (degH + 1)};
+
+	S.resize(RN + 1);
+	FOR(ri,0,RN+1)
+	{
+		S[ri].resize(CN + 1);
+		getSampleFn(Real())(table->data() + ri * (CN + 1) * N, getPoints(E), CN + 1, S[ri].data());
+	}
+}
+
+template <class Real>
+void TMeshEvaluator::tessellateElement(int e, int RN, int CN, Vector<Real, 4> *S) const
+{
+	const TElement &E {elements[e]};
+	const BasisTablePtr table {BasisTableCache::shared().get(*this, E, RN, CN)};
+	// The table rows follow each other, as the rows of S
+	getSampleFn(Real())(table->data(), getPoints(E), (RN + 1) * (CN + 1), S);
+}
+
+template void TMeshEvaluator::tessellateElement<double>(int e, int RN, int CN, VVP3 &S) const;
+template void TMeshEvaluator::tessellateElement<float>(int e, int RN, int CN, VVP3f &S) const;
+template void TMeshEvaluator::tessellateElement<double>(int e, int RN, int CN, Pt3 *S) const;
+template void TMeshEvaluator::tessellateElement<float>(int e, int RN, int CN, Pt3f *S) const;
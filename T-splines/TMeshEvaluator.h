@@ -0,0 +1,287 @@
+#ifndef T_MESH_EVALUATOR_H
+#define T_MESH_EVALUATOR_H
+
+#include "TMesh.h"
+
+#include <memory>
+
+// Describes each node in the pyramid in the de Boor Algorithm
+struct PyramidNode
+{
+	// Denote parameters t_l or t_r along the up-left (t-t_l) or up-right (t_r-t) arrow
+	double knotL, knotR;
+	// Coordinates of the point
+	Pt3 point;
+};
+
+namespace DeBoorUtil {
+	/*
+	 * Run the local de Boor Algorithm on deg+1 nodes in place and return the top
+	 * of the pyramid. Only the caller's (stack) memory is touched.
+	 * If 'deriv' is given, it receives the first derivative at t.
+	 */
+	inline Pt3 localDeBoor(int deg, double t, PyramidNode *layer, Vec3 *deriv = NULL)
+	{
+		for(int i = deg; i >= 1; --i)
+		{
+			// With 2 points left, their difference gives the derivative (if asked)
+			if(i == 1 and deriv)
+			{
+				*deriv = (layer[1].point - layer[0].point) * (deg / (layer[0].knotR - layer[1].knotL));
+				(*deriv)[3] = 0;
+			}
+
+			// At this moment, we have i+1 points in 'layer'; replace them with i points.
+			// Node j only depends on nodes j and j+1, so going forward is safe.
+			for(int j = 0; j < i; ++j)
+			{
+				double ta = layer[j + 1].knotL;
+				double tb = layer[j].knotR;
+				layer[j].knotL = ta;
+				layer[j].point =
+					layer[j].point * ((tb-t) / (tb-ta)) +
+					layer[j+1].point * ((t-ta) / (tb-ta));
+			}
+		}
+		return layer[0].point;
+	}
+
+	// Update the index 'p' to cover the appropriate knot values given a particular parameter t
+	inline void updateSegmentIndex(int &p, int n, double t, const double *knots)
+	{
+		while(p + 1 < n and (t > knots[p + 1] + 1e-9 or abs(knots[p] - knots[p + 1]) < 1e-9))
+			++p;
+	}
+
+	// Retrieve parameters t_l or t_r along the up-left (t-t_l) or up-right (t_r-t) arrow
+	inline void populateKnotLR(PyramidNode &node, int p, int deg, const double *knots, int n)
+	{
+		int idL = p - deg;
+		int idR = p + 1;
+		node.knotL = (idL < 0) ? 0 : knots[idL];
+		node.knotR = (idR >= n) ? 0 : knots[idR];
+	}
+}
+using namespace DeBoorUtil;
+
+namespace UniformUtil {
+	/*
+	 * Uniform B-spline matrices of degrees 1-5 (times BSPLINE_SCALES[deg]): on a
+	 * span of uniform knots, with u in [0, 1] across the span, the basis value
+	 * of point j is sum_k u^k BSPLINE_MATRICES[deg][k][j] / BSPLINE_SCALES[deg].
+	 */
+	constexpr double BSPLINE_SCALES[6] {1, 1, 2, 6, 24, 120};
+	constexpr double BSPLINE_MATRICES[6][6][6] {
+		{},
+		{
+			{ 1,  0},
+			{-1,  1}
+		},
+		{
+			{ 1,  1,  0},
+			{-2,  2,  0},
+			{ 1, -2,  1}
+		},
+		{
+			{ 1,  4,  1,  0},
+			{-3,  0,  3,  0},
+			{ 3, -6,  3,  0},
+			{-1,  3, -3,  1}
+		},
+		{
+			{ 1,  11,  11,   1,  0},
+			{-4, -12,  12,   4,  0},
+			{ 6,  -6,  -6,   6,  0},
+			{-4,  12, -12,   4,  0},
+			{ 1,  -4,   6,  -4,  1}
+		},
+		{
+			{  1,  26,  66,  26,   1,  0},
+			{ -5, -50,   0,  50,   5,  0},
+			{ 10,  20, -60,  20,  10,  0},
+			{-10,  20,   0, -20,  10,  0},
+			{  5, -20,  30, -20,   5,  0},
+			{ -1,   5, -10,  10,  -5,  1}
+		}
+	};
+
+	// Whether the n local knots are equally spaced (and not repeated)
+	inline bool isUniform(const double *K, int n)
+	{
+		const double h {K[1] - K[0]};
+		if(h < 1e-9) return false;
+		FOR(j,1,n-1) if(abs(K[j + 1] - K[j] - h) > 1e-9 * max(1.0, h)) return false;
+		return true;
+	}
+
+	/*
+	 * The deg+1 basis values at t for the 2*deg uniform local knots K (the
+	 * polynomial of span [K[deg-1], K[deg]]). With a constant 'deg', the loops
+	 * have fixed sizes once inlined.
+	 */
+	inline void uniformBasis(int deg, const double *K, double t, double *b)
+	{
+		const double u {(t - K[deg - 1]) / (K[deg] - K[deg - 1])};
+		const auto &M = BSPLINE_MATRICES[deg];
+		FOR(j,0,deg+1)
+		{
+			double v {M[deg][j]};
+			for(int k = deg - 1; k >= 0; --k)
+				v = v * u + M[k][j];
+			b[j] = v / BSPLINE_SCALES[deg];
+		}
+	}
+}
+using namespace UniformUtil;
+
+/*
+ * A unit element compiled for evaluation: everything the local de Boor
+ * algorithm needs, copied out of the T-mesh so that no mesh access is needed.
+ * Its control points and local knots live in the evaluator (see
+ * TMeshEvaluator::getPoints() and friends), as their counts depend on the
+ * degrees. Blending by row first, there are degV+1 inner (row) curves of
+ * degree degH, then one outer pass of degree degV; by column first, the
+ * other way round.
+ */
+struct TElement
+{
+	int ur, uc; // unit element (row, column) in the T-mesh
+	double s0, s1; // vertical parameter range (rows)
+	double t0, t1; // horizontal parameter range (columns)
+	bool rowFirst; // blend by row (horizontal) first, then by column
+	bool uniform; // all local knot vectors are uniform (no de Boor pyramid needed)
+	int points; // first of its (degV+1) x (degH+1) control points, row-major
+	int knots; // first of its local knot vectors: one per inner curve, then the outer one
+};
+
+/*
+ * The topology-derived part of a unit element: which control points it
+ * blends. Knot values and positions don't change it, so it is shared by the
+ * evaluators of a mesh as long as its edges stay the same.
+ */
+struct TElementAnchors
+{
+	int ur, uc;
+	bool rowFirst;
+	pair<int,int> points[16]; // grid positions (capped) of the blending points, row-major
+};
+
+/*
+ * An immutable evaluator compiled from a T-mesh snapshot.
+ *
+ * All state is copied at construction, and every query is const and only
+ * uses stack memory (sampling also uses the thread-safe basis cache), so
+ * any number of threads may share one evaluator without locking.
+ * Share it as shared_ptr<const TMeshEvaluator>.
+ * The mesh must be locked by the caller only while constructing.
+ */
+class TMeshEvaluator
+{
+public:
+	/*
+	 * If 'previous' was compiled from an earlier state of the same mesh with
+	 * the same topology (only knots or positions changed since), its anchor
+	 * tables are reused and only the knot spans, local knot vectors and
+	 * control points are looked up again.
+	 */
+	explicit TMeshEvaluator(const TMesh &T, const TMeshEvaluator *previous = NULL);
+
+	int getRows() const { return rows; }
+	int getCols() const { return cols; }
+	int getDegH() const { return degH; }
+	int getDegV() const { return degV; }
+	int numElements() const { return SZ(elements); }
+	const TElement &getElement(int e) const { return elements[e]; }
+
+	// Degrees of the inner and outer de Boor passes of an element
+	int innerDegree(const TElement &E) const { return E.rowFirst ? degH : degV; }
+	int outerDegree(const TElement &E) const { return E.rowFirst ? degV : degH; }
+	// The (degV+1) x (degH+1) control points of an element, row-major
+	const Pt3 *getPoints(const TElement &E) const { return &points[E.points]; }
+	// Point j of inner curve i (0 <= i <= outer degree, 0 <= j <= inner degree)
+	const Pt3 &getInnerPoint(const TElement &E, int i, int j) const
+	{
+		return points[E.points + (E.rowFirst ? i * (degH + 1) + j : j * (degH + 1) + i)];
+	}
+	// Local knots (2 x degree) of inner curve i and of the outer pass
+	const double *getKnotsInner(const TElement &E, int i) const
+	{
+		return &knots[E.knots + i * 2 * innerDegree(E)];
+	}
+	const double *getKnotsOuter(const TElement &E) const
+	{
+		return &knots[E.knots + (outerDegree(E) + 1) * 2 * innerDegree(E)];
+	}
+
+	// Knot values of row index line r (0 <= r <= rows) and column index line c (0 <= c <= cols)
+	double getRowKnot(int r) const { return knotsV[r + spanOffsetV()]; }
+	double getColKnot(int c) const { return knotsH[c + spanOffsetH()]; }
+	// Index of unit element (ur, uc), or -1 if it has no element
+	int elementAt(int ur, int uc) const
+	{
+		if(ur < 0 or ur >= rows or uc < 0 or uc >= cols) return -1;
+		return elementIds[ur * cols + uc];
+	}
+	// Diagonal of the bounding box of the elements' control points
+	double getSize() const { return size; }
+
+	// Index of the element covering parameters (s,t), or -1 if there is none
+	int findElement(double s, double t) const;
+	// Evaluate the surface at (s,t). Returns false if (s,t) is not covered.
+	bool evaluate(double s, double t, Pt3 &res) const;
+	// Evaluate element e at (s,t) (which should lie inside the element)
+	Pt3 evaluateElement(int e, double s, double t) const;
+	/*
+	 * Sample element e on a uniform (RN+1) x (CN+1) parameter grid (through
+	 * BasisTableCache::shared()), into double (VVP3) or float (VVP3f) points.
+	 * Float samples are summed in single precision; each coordinate is within
+	 * getFloatError() of the double samples.
+	 */
+	template <class Real>
+	void tessellateElement(int e, int RN, int CN, vector<vector<Vector<Real, 4>>> &S) const;
+	// The same samples, row by row into S[0 .. (RN+1)(CN+1))
+	template <class Real>
+	void tessellateElement(int e, int RN, int CN, Vector<Real, 4> *S) const;
+	/*
+	 * Bound on the error of float samples per coordinate: (N+2) 2^-24 max|P|
+	 * for N = (degH+1)(degV+1) points per element and max|P| the largest
+	 * control point coordinate (about 1.1e-6 max|P| for bicubic surfaces).
+	 * Points computed in double and stored as float are within 2^-24 |x|.
+	 */
+	double getFloatError() const { return floatError; }
+
+	// Kernels specialized per pair of degrees, picked once per evaluator
+	typedef Pt3 (*BlendFn)(const TMeshEvaluator &eval, const TElement &E, double tIn, double tOut);
+	template <class Real>
+	using SampleFn = void (*)(const double *weights, const Pt3 *P, int count, Vector<Real, 4> *res);
+
+private:
+	int rows, cols;
+	int degH, degV;
+	unsigned topologyGen; // of the mesh compiled from
+	double size;
+	double floatError; // see getFloatError()
+	vector<double> knotsH, knotsV;
+	shared_ptr<const vector<TElementAnchors>> anchors; // element candidates, knots aside
+	vector<TElement> elements;
+	VP3 points; // control points of all elements
+	vector<double> knots; // local knot vectors of all elements
+	vector<int> elementIds; // (ur * cols + uc) -> index in 'elements' or -1
+	BlendFn blendRows, blendCols; // evaluate row-first and column-first elements
+	SampleFn<double> sample; // weigh the control points of an element with a basis table
+	SampleFn<float> sampleFloat; // the same in single precision
+	SampleFn<double> getSampleFn(double) const { return sample; }
+	SampleFn<float> getSampleFn(float) const { return sampleFloat; }
+
+	// Cubic T-meshes: elements from the blending points of the anchors
+	void compileTMesh(const TMesh &T, const TMeshEvaluator *previous);
+	// Other degrees (full grids only): tensor-product B-spline elements
+	void compileGrid(const TMesh &T);
+	// Find the blending points of every live unit element (the costly, topology-only part)
+	static shared_ptr<const vector<TElementAnchors>> findAnchors(const TMesh &T);
+	// Unit element row ur covers the knot span [knotsV[p], knotsV[p+1]] with p = ur + spanOffsetV()
+	int spanOffsetV() const { return (degV - 1) / 2; }
+	int spanOffsetH() const { return (degH - 1) / 2; }
+};
+
+#endif // T_MESH_EVALUATOR_H
@@ -0,0 +1,36 @@
+#include "TMeshHistory.h"
+
+void TMeshHistory::reset(const TMesh &mesh)
+{
+	states.assign(1, mesh.snapshot());
+	current = 0;
+}
+
+void TMeshHistory::record(const TMesh &mesh)
+{
+	TMeshSnapshot S {mesh.snapshot()};
+	if(current >= 0 and states[current] == S) // nothing new was published
+		return;
+
+	states.erase(states.begin() + (current + 1), states.end());
+	states.push_back(move(S));
+	if(SZ(states) > maxSteps)
+		states.pop_front();
+	current = SZ(states) - 1;
+}
+
+bool TMeshHistory::undo(TMesh &mesh)
+{
+	if(not canUndo())
+		return false;
+	mesh.restore(states[--current]);
+	return true;
+}
+
+bool TMeshHistory::redo(TMesh &mesh)
+{
+	if(not canRedo())
+		return false;
+	mesh.restore(states[++current]);
+	return true;
+}
@@ -0,0 +1,36 @@
+#ifndef T_MESH_HISTORY_H
+#define T_MESH_HISTORY_H
+
+#include "TMesh.h"
+
+#include <deque>
+
+/*
+ * Undo/redo history of a T-mesh, kept as published snapshots. Consecutive
+ * states share all rows that an edit did not touch, so a step costs O(rows)
+ * plus the changed rows, and undoing it restores the derived info as well.
+ * All calls must come from the thread that edits the mesh.
+ */
+class TMeshHistory
+{
+public:
+	explicit TMeshHistory(int maxSteps = 256) : current(-1), maxSteps(maxSteps) {}
+
+	// Forget everything; the published state of 'mesh' becomes the only one
+	void reset(const TMesh &mesh);
+	// Add the published state of 'mesh' after an edit (drops the redo steps)
+	void record(const TMesh &mesh);
+
+	bool canUndo() const { return current > 0; }
+	bool canRedo() const { return current + 1 < SZ(states); }
+	// Restore the previous/next state into 'mesh' (the caller holds its lock)
+	bool undo(TMesh &mesh);
+	bool redo(TMesh &mesh);
+
+private:
+	deque<TMeshSnapshot> states;
+	int current; // index of the state the mesh is in
+	int maxSteps;
+};
+
+#endif // T_MESH_HISTORY_H
@@ -0,0 +1,452 @@
+#include "TMeshTessellator.h"
+
+#include <atomic>
+
+/*
+ * Bounds for the span [K[DEG-1], K[DEG]] of DEG+1 control points Q with
+ * 2*DEG local knots K: the mean speed |C'| and the max curvature term |C''|,
+ * both taken from the derivative control points (the curve's derivatives
+ * lie in their convex hull).
+ */
+template <int DEG>
+static void derivativeBounds(const Pt3 *Q[], const double *K, double &speed, double &accel)
+{
+	Vec3 D1[DEG + 1];
+	speed = 0;
+	FOR(j,1,DEG+1)
+	{
+		D1[j] = (*Q[j] - *Q[j - 1]) * (DEG / (K[j + DEG - 1] - K[j - 1]));
+		D1[j][3] = 0;
+		speed += mag(D1[j]) / DEG;
+	}
+	accel = 0;
+	FOR(j,2,DEG+1)
+	{
+		Vec3 D2 {(D1[j] - D1[j - 1]) * ((DEG - 1) / (K[j + DEG - 2] - K[j - 1]))};
+		D2[3] = 0;
+		accel = max(accel, mag(D2));
+	}
+}
+
+// Kernel table for degrees 1 to MAX_SURFACE_DEGREE
+static_assert(MAX_SURFACE_DEGREE == 5, "extend the kernel table");
+typedef void (*DerivativeBoundsFn)(const Pt3 *Q[], const double *K, double &speed, double &accel);
+static const DerivativeBoundsFn DERIVATIVE_BOUNDS[5] {
+	derivativeBounds<1>, derivativeBounds<2>, derivativeBounds<3>, derivativeBounds<4>, derivativeBounds<5>
+};
+
+const int TessellationCache::MAX_LEVELS;
+
+shared_ptr<const VVP3> TessellationCache::getGrid(const TMeshEvaluator &eval, int e, int RN, int CN)
+{
+	Element &E {elements[e]};
+	lock_guard<mutex> guard(E.lock);
+	auto it = E.levels.find({RN, CN});
+	if(it != end(E.levels))
+		return it->second;
+
+	if(SZ(E.levels) >= MAX_LEVELS)
+		E.levels.clear();
+	auto S = make_shared<VVP3>();
+	eval.tessellateElement(e, RN, CN, *S);
+	E.levels[{RN, CN}] = S;
+	return S;
+}
+
+TMeshTessellator::TMeshTessellator(TMeshEvaluatorPtr e, const TessellationOptions &o)
+	: eval(move(e)), opt(o)
+{
+	chordTol = max(1e-12, opt.chordTol * eval->getSize());
+	normalTol = max(1e-6, opt.normalTol * M_PI / 180);
+
+	// Samples needed along one direction of width w: a chord of length h
+	// deviates by at most h^2/8 |C''|, and the normal turns by about h |C''|/|C'|
+	bounds.resize(eval->numElements());
+	parallelFor(SZ(bounds), 64, [&](int begin, int end)
+	{
+		FOR(e,begin,end)
+		{
+			const TElement &E {eval->getElement(e)};
+			double chord[2] {0, 0}, length[2] {0, 0};
+			int normal[2] {0, 0};
+			auto add = [&](int dir, double w, double speed, double accel)
+			{
+				chord[dir] = max(chord[dir], w * sqrt(accel / 8));
+				length[dir] = max(length[dir], w * speed);
+				if(speed > 1e-12 * eval->getSize())
+					normal[dir] = max(normal[dir], int(min(1e6, ceil(w * accel / (speed * normalTol)))));
+			};
+
+			// Inner direction: each inner curve uses its own knots
+			const int dirInner {E.rowFirst ? 1 : 0};
+			const double wInner {E.rowFirst ? E.t1 - E.t0 : E.s1 - E.s0};
+			const double wOuter {E.rowFirst ? E.s1 - E.s0 : E.t1 - E.t0};
+			const int dIn {eval->innerDegree(E)}, dOut {eval->outerDegree(E)};
+			const DerivativeBoundsFn boundsIn {DERIVATIVE_BOUNDS[dIn - 1]}, boundsOut {DERIVATIVE_BOUNDS[dOut - 1]};
+			FOR(i,0,dOut+1)
+			{
+				const Pt3 *Q[MAX_SURFACE_DEGREE + 1];
+				FOR(j,0,dIn+1) Q[j] = &eval->getInnerPoint(E, i, j);
+				double speed, accel;
+				boundsIn(Q, eval->getKnotsInner(E, i), speed, accel);
+				add(dirInner, wInner, speed, accel);
+			}
+
+			// Outer direction: differences across the inner curves
+			FOR(j,0,dIn+1)
+			{
+				const Pt3 *Q[MAX_SURFACE_DEGREE + 1];
+				FOR(i,0,dOut+1) Q[i] = &eval->getInnerPoint(E, i, j);
+				double speed, accel;
+				boundsOut(Q, eval->getKnotsOuter(E), speed, accel);
+				add(1 - dirInner, wOuter, speed, accel);
+			}
+
+			ElementBounds &B {bounds[e]};
+			B.chordS = chord[0];
+			B.chordT = chord[1];
+			B.normalS = normal[0];
+			B.normalT = normal[1];
+			B.lengthS = length[0];
+			B.lengthT = length[1];
+
+			const Pt3 *P {eval->getPoints(E)};
+			Pt3 lo {P[0]}, hi {lo};
+			FOR(i,0,(dIn+1)*(dOut+1)) FOR(k,0,3)
+			{
+				lo[k] = min(lo[k], P[i][k]);
+				hi[k] = max(hi[k], P[i][k]);
+			}
+			B.center = (lo + hi) * 0.5;
+			B.center[3] = 1;
+			Vec3 d {hi - lo};
+			d[3] = 0;
+			B.radius = mag(d) / 2;
+		}
+	});
+}
+
+int TMeshTessellator::samples(double chord, int normal, double tol) const
+{
+	const double n {max(chord / sqrt(tol), double(normal))};
+	return int(max(2.0, min(double(opt.maxN), ceil(n))));
+}
+
+pair<int,int> TMeshTessellator::elementDensity(int e) const
+{
+	const ElementBounds &B {bounds[e]};
+	return {samples(B.chordS, B.normalS, chordTol), samples(B.chordT, B.normalT, chordTol)};
+}
+
+void TMeshTessellator::computeDensities(vector<pair<int,int>> &density) const
+{
+	density.resize(eval->numElements());
+	parallelFor(SZ(density), 64, [&](int begin, int end)
+	{
+		FOR(e,begin,end) density[e] = elementDensity(e);
+	});
+}
+
+void TMeshTessellator::screenDensities(const Mat4 &modelview, const Mat4 &proj, int width, int height,
+	vector<pair<int,int>> &density) const
+{
+	density.resize(eval->numElements());
+	const Mat4 MVP {modelview * proj};
+
+	// Round up to a power of two (at least 2, at most maxN)
+	int maxN {2};
+	while(maxN * 2 <= opt.maxN) maxN *= 2;
+	auto level = [&](int n)
+	{
+		int m {2};
+		while(m < n and m < maxN) m *= 2;
+		return m;
+	};
+
+	// World size of one pixel at clip depth w (w grows with the distance)
+	const double pixelScale {min(2 / (abs(proj[0][0]) * max(1, width)), 2 / (abs(proj[1][1]) * max(1, height)))};
+
+	// Serial: this runs on the UI thread for every frame, and is a few products per element
+	FOR(e,0,SZ(density))
+	{
+		const ElementBounds &B {bounds[e]};
+		const Pt3 c {B.center * MVP};
+
+		// Behind the camera: coarsest; reaching the near plane: finest
+		const double wNear {c[3] - B.radius};
+		if(c[3] + B.radius <= 0)
+		{
+			density[e] = {2, 2};
+			continue;
+		}
+		if(wNear <= 1e-6)
+		{
+			density[e] = {maxN, maxN};
+			continue;
+		}
+
+		// Outside the view frustum: coarsest
+		const double rx {B.radius * abs(proj[0][0])};
+		const double ry {B.radius * abs(proj[1][1])};
+		if(c[0] - rx > c[3] + B.radius or c[0] + rx < -c[3] - B.radius or
+			c[1] - ry > c[3] + B.radius or c[1] + ry < -c[3] - B.radius)
+		{
+			density[e] = {2, 2};
+			continue;
+		}
+
+		// The pixel tolerance in world units at the nearest point of the element,
+		// and no segments shorter than a pixel
+		const double pixel {pixelScale * wNear};
+		const double tol {max(1e-12, opt.pixelTol * pixel)};
+		const int capS {int(ceil(B.lengthS / pixel))};
+		const int capT {int(ceil(B.lengthT / pixel))};
+		density[e] = {
+			level(min(capS, samples(B.chordS, B.normalS, tol))),
+			level(min(capT, samples(B.chordT, B.normalT, tol)))};
+	}
+}
+
+bool TMeshTessellator::tessellate(VP3 &points, vector<TriInd> &tris, const function<bool ()> &cancelled) const
+{
+	vector<pair<int,int>> density;
+	computeDensities(density);
+	if(cancelled and cancelled())
+		return false;
+	return tessellate(density, points, tris, NULL, cancelled);
+}
+
+bool TMeshTessellator::tessellate(const vector<pair<int,int>> &density, VP3 &points, vector<TriInd> &tris,
+	TessellationCache *cache, const function<bool ()> &cancelled) const
+{
+	points.clear();
+	tris.clear();
+	const int ne {eval->numElements()};
+	if(ne == 0) return true;
+
+	// Any thread seeing the cancellation stops the others
+	atomic<bool> stopped {false};
+	auto stop = [&]()
+	{
+		if(not stopped and cancelled and cancelled())
+			stopped = true;
+		return bool(stopped);
+	};
+
+	// Knot lines by value: the index lines on both sides of a zero-width row
+	// or column (a repeated knot) are the same line, so that the elements
+	// across it share their nodes and edges
+	auto distinct = [](int n, const function<double (int)> &knot)
+	{
+		VI line(n + 1, 0);
+		FOR(i,1,n+1)
+			line[i] = line[i - 1] + (knot(i) - knot(i - 1) > 1e-9 ? 1 : 0);
+		return line;
+	};
+	const VI lineS {distinct(eval->getRows(), [&](int r) { return eval->getRowKnot(r); })};
+	const VI lineT {distinct(eval->getCols(), [&](int c) { return eval->getColKnot(c); })};
+
+	// Node (i, j) is where row line i and column line j cross; the top-left
+	// corner of element E is node (lineS[E.ur], lineT[E.uc])
+	const int W {lineT.back() + 1};
+	const int nodes {(lineS.back() + 1) * W};
+	auto nodeKey = [&](const TElement &E) { return lineS[E.ur] * W + lineT[E.uc]; };
+	VI nodeId(nodes, -1); // vertex of each node
+	VI hEdgeId(nodes, -1), hEdgeN(nodes, 0); // first inner vertex and #pieces of edge (r,c)-(r,c+1)
+	VI vEdgeId(nodes, -1), vEdgeN(nodes, 0); // first inner vertex and #pieces of edge (r,c)-(r+1,c)
+	VI hEdgeOwner(nodes, -1), vEdgeOwner(nodes, -1); // an element sampling the edge at its density
+	VI innerId(ne);
+
+	// Where each vertex comes from: sample (r, c) of element e's grid
+	struct Sample { int e, r, c; };
+	vector<Sample> samples;
+
+	auto addNode = [&](int e, int node, int r, int c)
+	{
+		int &id {nodeId[node]};
+		if(id < 0)
+		{
+			id = SZ(samples);
+			samples.push_back({e, r, c});
+		}
+	};
+
+	// An edge is shared by two elements and is sampled once, by the finer one
+	auto addEdge = [&](int e, VI &edgeId, const VI &edgeOwner, int key, bool alongT, int fixed)
+	{
+		if(edgeOwner[key] != e) return;
+		edgeId[key] = SZ(samples);
+		FOR(k,1,(alongT ? density[e].second : density[e].first))
+			samples.push_back(alongT ? Sample {e, fixed, k} : Sample {e, k, fixed});
+	};
+
+	// Edge densities first (the finer of both sides), then vertex allocation
+	auto finer = [&](VI &edgeN, VI &edgeOwner, int key, int e, int n)
+	{
+		if(n > edgeN[key])
+		{
+			edgeN[key] = n;
+			edgeOwner[key] = e;
+		}
+	};
+	FOR(e,0,ne)
+	{
+		const int key {nodeKey(eval->getElement(e))};
+		finer(hEdgeN, hEdgeOwner, key, e, density[e].second);
+		finer(hEdgeN, hEdgeOwner, key + W, e, density[e].second);
+		finer(vEdgeN, vEdgeOwner, key, e, density[e].first);
+		finer(vEdgeN, vEdgeOwner, key + 1, e, density[e].first);
+	}
+	FOR(e,0,ne)
+	{
+		const int RN {density[e].first}, CN {density[e].second};
+		const int key {nodeKey(eval->getElement(e))};
+
+		addNode(e, key, 0, 0);
+		addNode(e, key + 1, 0, CN);
+		addNode(e, key + W, RN, 0);
+		addNode(e, key + W + 1, RN, CN);
+
+		addEdge(e, hEdgeId, hEdgeOwner, key, true, 0);
+		addEdge(e, hEdgeId, hEdgeOwner, key + W, true, RN);
+		addEdge(e, vEdgeId, vEdgeOwner, key, false, 0);
+		addEdge(e, vEdgeId, vEdgeOwner, key + 1, false, CN);
+
+		innerId[e] = SZ(samples);
+		FOR(r,1,RN) FOR(c,1,CN)
+			samples.push_back({e, r, c});
+	}
+
+	// Sample all element grids (cached or not), then gather the vertices
+	assert(not cache or cache->numElements() == ne);
+	vector<shared_ptr<const VVP3>> grid(ne);
+	parallelFor(ne, 16, [&](int begin, int end)
+	{
+		FOR(e,begin,end)
+		{
+			if(stop())
+				return;
+			if(cache)
+				grid[e] = cache->getGrid(*eval, e, density[e].first, density[e].second);
+			else
+			{
+				auto S = make_shared<VVP3>();
+				eval->tessellateElement(e, density[e].first, density[e].second, *S);
+				grid[e] = move(S);
+			}
+		}
+	});
+	if(stop())
+		return false;
+
+	points.resize(samples.size());
+	FOR(i,0,SZ(samples))
+		points[i] = (*grid[samples[i].e])[samples[i].r][samples[i].c];
+
+	// Triangulate each element: a regular grid inside, and 4 zipper strips
+	// between its inner ring and its (possibly finer) boundary
+	vector<vector<TriInd>> parts(ne);
+	parallelFor(ne, 64, [&](int begin, int end)
+	{
+		struct Vert { int id; double s, t; };
+
+		// Orient every triangle like the grid triangles (w, x, y) of the old meshes
+		auto addTri = [&](vector<TriInd> &T, const Vert &a, const Vert &b, const Vert &c)
+		{
+			const double area {(b.s - a.s) * (c.t - a.t) - (b.t - a.t) * (c.s - a.s)};
+			if(area >= 0) T.push_back(TriInd(a.id, b.id, c.id));
+			else T.push_back(TriInd(a.id, c.id, b.id));
+		};
+
+		// Join the polylines 'outer' and 'inner' (same end directions) with triangles
+		auto zipper = [&](vector<TriInd> &T, const vector<Vert> &outer, const vector<Vert> &inner, bool alongT)
+		{
+			auto u = [&](const Vert &v) { return alongT ? v.t : v.s; };
+			int i {0}, j {0};
+			while(i + 1 < SZ(outer) or j + 1 < SZ(inner))
+			{
+				if(j + 1 == SZ(inner) or (i + 1 < SZ(outer) and u(outer[i + 1]) <= u(inner[j + 1])))
+				{
+					addTri(T, outer[i], outer[i + 1], inner[j]);
+					++i;
+				}
+				else
+				{
+					addTri(T, outer[i], inner[j + 1], inner[j]);
+					++j;
+				}
+			}
+		};
+
+		FOR(e,begin,end)
+		{
+			if(stop())
+				return;
+			const TElement &E {eval->getElement(e)};
+			const int RN {density[e].first}, CN {density[e].second};
+			vector<TriInd> &T {parts[e]};
+
+			auto S = [&](int r) { return E.s0 + (E.s1 - E.s0) * r / RN; };
+			auto C = [&](int c) { return E.t0 + (E.t1 - E.t0) * c / CN; };
+			auto inner = [&](int r, int c) { return Vert {innerId[e] + (r - 1) * (CN - 1) + (c - 1), S(r), C(c)}; };
+
+			// Regular grid between the inner samples
+			FOR(r,1,RN-1) FOR(c,1,CN-1)
+			{
+				// wz : w  | wz
+				// xy : xy |  y
+				const Vert w {inner(r, c)};
+				const Vert x {inner(r + 1, c)};
+				const Vert y {inner(r + 1, c + 1)};
+				const Vert z {inner(r, c + 1)};
+				addTri(T, w, x, y);
+				addTri(T, w, y, z);
+			}
+
+			// Boundary polyline along an edge of the element, from its first node
+			// (the top-left corner, moved by one row or column for the far edges)
+			const int key {nodeKey(E)};
+			auto boundary = [&](bool far, bool alongT)
+			{
+				const int k {key + (far ? (alongT ? W : 1) : 0)};
+				const int n {alongT ? hEdgeN[k] : vEdgeN[k]};
+				const int first {alongT ? hEdgeId[k] : vEdgeId[k]};
+				const double s {alongT ? (far ? E.s1 : E.s0) : E.s0};
+				const double t {alongT ? E.t0 : (far ? E.t1 : E.t0)};
+
+				vector<Vert> P;
+				P.push_back({nodeId[k], s, t});
+				FOR(i,1,n)
+				{
+					if(alongT) P.push_back({first + i - 1, s, E.t0 + (E.t1 - E.t0) * i / n});
+					else P.push_back({first + i - 1, E.s0 + (E.s1 - E.s0) * i / n, t});
+				}
+				const int kEnd {alongT ? k + 1 : k + W};
+				if(alongT) P.push_back({nodeId[kEnd], s, E.t1});
+				else P.push_back({nodeId[kEnd], E.s1, t});
+				return P;
+			};
+
+			vector<Vert> top, bottom, left, right;
+			FOR(c,1,CN) top.push_back(inner(1, c));
+			FOR(c,1,CN) bottom.push_back(inner(RN - 1, c));
+			FOR(r,1,RN) left.push_back(inner(r, 1));
+			FOR(r,1,RN) right.push_back(inner(r, CN - 1));
+
+			zipper(T, boundary(false, true), top, true);
+			zipper(T, boundary(true, true), bottom, true);
+			zipper(T, boundary(false, false), left, false);
+			zipper(T, boundary(true, false), right, false);
+		}
+	});
+
+	if(stop())
+		return false;
+
+	size_t total {0};
+	for(auto &part: parts) total += part.size();
+	tris.reserve(total);
+	for(auto &part: parts)
+		tris.insert(end(tris), begin(part), end(part));
+	return true;
+}
@@ -0,0 +1,101 @@
+#ifndef T_MESH_TESSELLATOR_H
+#define T_MESH_TESSELLATOR_H
+
+#include "TMeshEvaluator.h"
+
+#include <mutex>
+
+/*
+ * Sample grids of the elements of one evaluator, cached per element and
+ * density. It is shared between the builds of one surface (on the UI thread
+ * and on the rebuild worker), so it may be used from several threads at
+ * once: each element has its own lock, and grids are handed out shared, so
+ * that they outlive their eviction.
+ */
+class TessellationCache
+{
+public:
+	explicit TessellationCache(int numElements) : elements(numElements) {}
+
+	int numElements() const { return SZ(elements); }
+	// Grid of element e at densities (RN, CN), evaluated on first use
+	shared_ptr<const VVP3> getGrid(const TMeshEvaluator &eval, int e, int RN, int CN);
+
+private:
+	// Densities kept per element before its grids are dropped
+	static const int MAX_LEVELS = 8;
+
+	struct Element
+	{
+		mutex lock;
+		map<pair<int,int>, shared_ptr<const VVP3>> levels; // (RN, CN) -> grid
+	};
+	vector<Element> elements;
+};
+
+/*
+ * Error-driven tessellation of a compiled T-mesh surface.
+ *
+ * Each element gets its own density along s (RN) and t (CN), estimated from
+ * the derivative control points of its rows and columns. Elements are sampled on a
+ * shared vertex grid: corners and edge samples belong to the knot lines, and
+ * an edge between elements of different densities uses the finer of the two.
+ * The coarser side is stitched to it with a zipper strip, so the output has
+ * no T-junction cracks. Like the evaluator, it may be used from any thread.
+ */
+class TMeshTessellator
+{
+public:
+	TMeshTessellator(TMeshEvaluatorPtr eval, const TessellationOptions &opt);
+
+	const TMeshEvaluatorPtr &getEvaluator() const { return eval; }
+	const TessellationOptions &getOptions() const { return opt; }
+
+	// Densities (RN, CN) of element e that meet the chordal and normal tolerances
+	pair<int,int> elementDensity(int e) const;
+	// Densities of all elements (in parallel)
+	void computeDensities(vector<pair<int,int>> &density) const;
+	/*
+	 * View-dependent densities: the chordal tolerance is 'pixelTol' pixels
+	 * at each element's distance under the given modelview and projection
+	 * (row-vector matrices, as in SceneInfo), for a width x height viewport.
+	 * Densities are powers of two, so that nearby views share cached grids.
+	 */
+	void screenDensities(const Mat4 &modelview, const Mat4 &proj, int width, int height,
+		vector<pair<int,int>> &density) const;
+
+	/*
+	 * Sample every element at the given densities (each at least 2) and
+	 * triangulate the samples into one indexed mesh. Element grids are
+	 * taken from 'cache' when given (built for the same evaluator). 'cancelled' is polled per element (from
+	 * several threads at once) and between the phases; once it returns true
+	 * the tessellation is abandoned, returning false.
+	 */
+	bool tessellate(const vector<pair<int,int>> &density, VP3 &points, vector<TriInd> &tris,
+		TessellationCache *cache = NULL, const function<bool ()> &cancelled = nullptr) const;
+	// Tessellate at the error-driven densities
+	bool tessellate(VP3 &points, vector<TriInd> &tris, const function<bool ()> &cancelled = nullptr) const;
+
+private:
+	// Per-element estimates along s and t, from the derivative bounds
+	struct ElementBounds
+	{
+		double chordS, chordT; // samples needed = chord / sqrt(absolute tolerance)
+		int normalS, normalT; // samples needed for the normal tolerance
+		double lengthS, lengthT; // approximate lengths of the element's sides
+		Pt3 center; // bounding sphere of the control points
+		double radius;
+	};
+
+	TMeshEvaluatorPtr eval;
+	TessellationOptions opt;
+	double chordTol; // absolute chordal tolerance
+	double normalTol; // normal tolerance in radians
+	vector<ElementBounds> bounds;
+
+	int samples(double chord, int normal, double tol) const;
+};
+
+typedef shared_ptr<const TMeshTessellator> TMeshTessellatorPtr;
+
+#endif // T_MESH_TESSELLATOR_H
@@ -0,0 +1,481 @@
+/*
+ * Checks of the non-GUI parts (evaluation, tessellation, history, mesh
+ * orderings, sharing between threads), as a console program built by
+ * Tests.vcxproj from the sources listed there, which runs it after each
+ * build. Exits with the number of failures.
+ */
+#include "Rendering/MeshOptimizer.h"
+#include "SceneRebuilder.h"
+#include "TCurveArcLength.h"
+#include "TMesh.h"
+#include "TMeshBasisCache.h"
+#include "TMeshTessellator.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+static int failures {0};
+
+#define CHECK(cond) \
+	do { if(not (cond)) { printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); failures++; } } while(0)
+
+// Equal steps of arc length cut a straight curve with uneven control points into equal segments
+static void testArcLengthSpacing()
+{
+	const int n {12};
+	TMesh L(n, 0, 3, 0);
+	FOR(i,0,n+1)
+	{
+		const double x {i * i / double(n)}; // speeds up along the curve
+		L.gridPoints[i][0].position = Pt3(x, 2 * x, -x, 1);
+	}
+	auto curve = make_shared<const TCurveEvaluator>(L);
+	const TCurveArcLength A(curve);
+
+	const Vec3 chord {curve->evaluate(curve->getEnd()) - curve->evaluate(curve->getStart())};
+	CHECK(abs(A.getLength() - mag(chord)) < 1e-9 * A.getLength());
+
+	const int steps {37};
+	const double step {A.getLength() / steps};
+	VP3 P;
+	A.pointsAtSpacing(step, P);
+	CHECK(SZ(P) == steps + 1);
+	FOR(i,0,SZ(P)-1)
+		CHECK(abs(mag(P[i + 1] - P[i]) - step) < 1e-8 * step);
+
+	// Unsorted queries land on the same points
+	vector<double> ds;
+	FOR(i,0,steps+1)
+		ds.push_back((steps - i) * step);
+	VP3 Q;
+	A.pointsAt(ds, Q);
+	FOR(i,0,steps+1)
+		CHECK(mag(Q[i] - P[steps - i]) < 1e-8 * step);
+}
+
+/*
+ * Stitching keeps a surface with a repeated interior knot in one piece: the
+ * elements on both sides of the zero-width column share their boundary
+ * samples, each edge has at most two triangles, and the mesh is a disk.
+ */
+static void testRepeatedKnotStitching()
+{
+	TMesh T(6, 6, 3, 3);
+	T.beginEdit();
+	T.setKnots(false, {0, 0, 0, 1, 2, 2, 4, 4, 4});
+	T.commitEdit();
+	auto eval = make_shared<const TMeshEvaluator>(T);
+	const TMeshTessellator tess(eval, TessellationOptions());
+
+	// Neighbors of different densities, so that the edges are zipped
+	vector<pair<int,int>> density(eval->numElements());
+	FOR(e,0,SZ(density))
+		density[e] = {2 + e % 3, 3 + e % 2};
+	VP3 P;
+	vector<TriInd> tris;
+	tess.tessellate(density, P, tris);
+	CHECK(not tris.empty());
+
+	FOR(i,0,SZ(P)) FOR(j,i+1,SZ(P))
+		CHECK(mag(P[i] - P[j]) > 1e-9 * eval->getSize());
+
+	map<pair<int,int>, int> edges;
+	for(const TriInd &t: tris) FOR(k,0,3)
+	{
+		const int a {t[k]}, b {t[(k + 1) % 3]};
+		edges[{min(a, b), max(a, b)}]++;
+	}
+	for(auto &edge: edges)
+		CHECK(edge._2 <= 2);
+	CHECK(SZ(P) - SZ(edges) + SZ(tris) == 1);
+}
+
+// Deriving the mesh info after a single-edge edit only replaces the rows around the edge
+static void testEditKeepsRowsShared()
+{
+	const int n {12}, r0 {n-2}, c0 {0};
+	TMesh T(n, n, 3, 3);
+	const TMeshSnapshot S {T.snapshot()};
+	T.beginEdit();
+	T.setEdge(false, r0, c0, false); // a T-junction next to the left boundary
+	T.commitEdit();
+	CHECK(T.isAS);
+
+	CHECK(not T.gridPoints.sharesRow(S->gridPoints, r0));
+	CHECK(not T.gridH.sharesRow(S->gridH, r0));
+	FOR(r,0,n+1) if(abs(r - r0) > 3)
+	{
+		CHECK(T.gridPoints.sharesRow(S->gridPoints, r));
+		CHECK(T.gridH.sharesRow(S->gridH, r));
+		CHECK(T.knotsRows.sharesRow(S->knotsRows, r));
+	}
+	FOR(r,0,n) if(abs(r - r0) > 3)
+	{
+		CHECK(T.gridV.sharesRow(S->gridV, r));
+		CHECK(T.blendDir.sharesRow(S->blendDir, r));
+	}
+	FOR(c,0,n+1) if(abs(c - c0) > 3)
+		CHECK(T.knotsCols.sharesRow(S->knotsCols, c));
+}
+
+// Triangle (a, b, c) rotated to start at its smallest index, which keeps its orientation
+static array<int,3> rotated(int a, int b, int c)
+{
+	if(b < a and b < c) return {{b, c, a}};
+	if(c < a and c < b) return {{c, a, b}};
+	return {{a, b, c}};
+}
+
+/*
+ * Reordering a stitched mesh for the vertex cache keeps its triangles and
+ * their orientation, and the strips of the built mesh decode back to its
+ * triangle list.
+ */
+static void testMeshOrdering()
+{
+	TMesh T(6, 6, 3, 3);
+	T.beginEdit();
+	FOR(r,0,7) FOR(c,0,7)
+		T.setPosition(r, c, Pt3(c, r, (r * c) % 3, 1));
+	T.commitEdit();
+	auto eval = make_shared<const TMeshEvaluator>(T);
+	TessellationOptions opt;
+	opt.adaptive = true;
+	VP3 P;
+	vector<TriInd> tris;
+	TMeshTessellator(eval, opt).tessellate(P, tris);
+
+	vector<TriInd> R {tris};
+	vector<int> order;
+	MeshOptimizer::optimizeVertexCache(R.data(), SZ(R), SZ(P));
+	MeshOptimizer::optimizeVertexFetch(R.data(), SZ(R), SZ(P), order);
+	CHECK(SZ(order) == SZ(P));
+	vector<array<int,3>> before, after;
+	for(const TriInd &t: tris)
+		before.push_back(rotated(t[0], t[1], t[2]));
+	for(const TriInd &t: R)
+		after.push_back(rotated(order[t[0]], order[t[1]], order[t[2]]));
+	sort(begin(before), end(before));
+	sort(begin(after), end(after));
+	CHECK(before == after);
+
+	SceneBuildSettings settings;
+	settings.options = opt;
+	SceneBuffer buf;
+	CHECK(TriMeshScene::buildSurface(eval, settings, buf));
+	const CompactMesh &M {*buf.mesh};
+	CHECK(M.numTriangles() == SZ(tris));
+
+	// Triangle i of a strip is (s[i], s[i+1], s[i+2]), with the first two swapped if i is odd
+	const unsigned restart {0xFFFFFFFF};
+	vector<unsigned> strip;
+	M.getStrips(strip, restart);
+	vector<array<int,3>> decoded;
+	for(int s {0}, i {0}; i <= SZ(strip); i++) if(i == SZ(strip) or strip[i] == restart)
+	{
+		CHECK(i - s >= 3);
+		FOR(k,s,i-2)
+		{
+			const int a {int(strip[k])}, b {int(strip[k + 1])}, c {int(strip[k + 2])};
+			decoded.push_back((k - s) % 2 == 0 ? rotated(a, b, c) : rotated(b, a, c));
+		}
+		s = i + 1;
+	}
+	CHECK(SZ(decoded) == M.numTriangles());
+	FOR(j,0,min(SZ(decoded), M.numTriangles()))
+		CHECK(decoded[j] == rotated(M.getInd(j, 0), M.getInd(j, 1), M.getInd(j, 2)));
+	CHECK(SZ(strip) < 3 * M.numTriangles()); // consecutive triangles do form strips
+}
+
+// Whether two point lists are exactly equal
+static bool samePoints(const VP3 &P, const VP3 &Q)
+{
+	if(SZ(P) != SZ(Q))
+		return false;
+	FOR(i,0,SZ(P)) if(mag(P[i] - Q[i]) != 0)
+		return false;
+	return true;
+}
+
+/*
+ * Two builds sharing one tessellation cache (the UI thread and the rebuild
+ * worker) get the meshes they would get alone, also while the cache evicts
+ * the grids of elements the other one is sampling.
+ */
+static void testSharedTessellationCache()
+{
+	TMesh T(8, 8, 3, 3);
+	auto eval = make_shared<const TMeshEvaluator>(T);
+	const TMeshTessellator tess(eval, TessellationOptions());
+	const int ne {eval->numElements()}, levels {12}; // more than a cache entry keeps
+	auto densities = [&](int level)
+	{
+		vector<pair<int,int>> density(ne);
+		FOR(e,0,ne)
+			density[e] = {2 + (level + e) % levels, 2 + level};
+		return density;
+	};
+	vector<VP3> expected(levels);
+	FOR(l,0,levels)
+	{
+		vector<TriInd> tris;
+		tess.tessellate(densities(l), expected[l], tris);
+	}
+
+	TessellationCache cache(ne);
+	atomic<int> mismatches {0};
+	auto run = [&](int offset)
+	{
+		FOR(k,0,4*levels)
+		{
+			const int l {(5 * k + offset) % levels};
+			VP3 P;
+			vector<TriInd> tris;
+			tess.tessellate(densities(l), P, tris, &cache);
+			if(not samePoints(P, expected[l]))
+				mismatches++;
+		}
+	};
+	thread other(run, 7);
+	run(0);
+	other.join();
+	CHECK(mismatches == 0);
+}
+
+/*
+ * An evaluator queried from several threads at once (points, and element
+ * grids through the shared basis tables) gives exactly the serial results.
+ */
+static void testConcurrentEvaluation()
+{
+	const int n {10};
+	TMesh T(n, n, 3, 3);
+	T.beginEdit();
+	FOR(r,0,n+1) FOR(c,0,n+1)
+		T.setPosition(r, c, Pt3(c, r, sin(r * c * 0.7), 1));
+	T.setEdge(false, n - 2, 0, false); // a T-junction
+	T.commitEdit();
+	CHECK(T.isAS);
+	auto eval = make_shared<const TMeshEvaluator>(T);
+	const int ne {eval->numElements()};
+
+	const double s0 {T.knotsV[2]}, s1 {T.knotsV[n]}, t0 {T.knotsH[2]}, t1 {T.knotsH[n]};
+	const int m {40};
+	VP3 expected(m * m);
+	FOR(i,0,m) FOR(j,0,m)
+		CHECK(eval->evaluate(s0 + (s1 - s0) * i / (m - 1), t0 + (t1 - t0) * j / (m - 1), expected[i * m + j]));
+	vector<VVP3> grids(ne);
+	FOR(e,0,ne)
+		eval->tessellateElement(e, 3 + e % 4, 5 - e % 3, grids[e]);
+
+	BasisTableCache::shared().clear(); // so that the threads race to fill it
+	atomic<int> mismatches {0};
+	auto run = [&](int offset)
+	{
+		FOR(k,0,m*m)
+		{
+			const int q {(k * 7 + offset) % (m * m)}, i {q / m}, j {q % m};
+			Pt3 P;
+			eval->evaluate(s0 + (s1 - s0) * i / (m - 1), t0 + (t1 - t0) * j / (m - 1), P);
+			if(mag(P - expected[q]) != 0)
+				mismatches++;
+		}
+		FOR(k,0,ne)
+		{
+			const int e {(k + offset) % ne};
+			VVP3 S;
+			eval->tessellateElement(e, 3 + e % 4, 5 - e % 3, S);
+			FOR(r,0,SZ(S)) if(not samePoints(S[r], grids[e][r]))
+				mismatches++;
+		}
+	};
+	vector<thread> threads;
+	FOR(i,1,4)
+		threads.emplace_back(run, 13 * i);
+	run(0);
+	for(auto &t: threads)
+		t.join();
+	CHECK(mismatches == 0);
+}
+
+/*
+ * Rebuild requests superseding each other: poll() only ever delivers the
+ * latest request (never a superseded or cancelled one), and the latest one
+ * is delivered once it is built.
+ */
+static void testRebuildOrdering()
+{
+	TMesh T(12, 12, 3, 3);
+	SceneBuildSettings settings;
+	settings.options.adaptive = true;
+	auto edit = [&](int k)
+	{
+		T.beginEdit();
+		T.setPosition(6, 6, Pt3(6, 6, k, 1));
+		T.commitEdit();
+		return T.snapshot();
+	};
+
+	SceneRebuilder R;
+	TMeshSnapshot latest, delivered;
+	int stale {0};
+	auto take = [&]()
+	{
+		auto buf = R.poll();
+		if(not buf)
+			return;
+		if(buf->source != latest)
+			stale++;
+		delivered = buf->source;
+	};
+	auto settle = [&]()
+	{
+		while(R.busy())
+		{
+			take();
+			this_thread::sleep_for(chrono::milliseconds(1));
+		}
+	};
+
+	// Requests at various intervals, some superseding builds in progress
+	FOR(k,0,30)
+	{
+		latest = edit(k);
+		R.request(latest, settings);
+		this_thread::sleep_for(chrono::microseconds(k % 5 * 300));
+		take();
+	}
+	settle();
+	CHECK(stale == 0);
+	CHECK(delivered == latest);
+
+	// Only the last of a burst is delivered
+	FOR(k,0,10)
+	{
+		latest = edit(100 + k);
+		R.request(latest, settings);
+	}
+	delivered = NULL;
+	settle();
+	CHECK(stale == 0);
+	CHECK(delivered == latest);
+
+	// Nothing is delivered after a cancel
+	R.request(edit(200), settings);
+	R.cancel();
+	delivered = latest = NULL;
+	settle();
+	CHECK(delivered == NULL);
+}
+
+/*
+ * A write to a SharedRows never shows in its copies (or they in it),
+ * whichever copies are released, moved or assigned in between, and also
+ * while another thread reads a copy.
+ */
+static void testSharedRowsCopies()
+{
+	typedef SharedRows<int>::Row Row;
+	SharedRows<int> A;
+	A.assign(4, Row(3, 0));
+	A[0][0] = 1;
+	const SharedRows<int> &cA {A};
+
+	SharedRows<int> B {A};
+	const SharedRows<int> &cB {B};
+	B[0][0] = 2;
+	A[1][1] = 3;
+	CHECK(cA[0][0] == 1 and cB[0][0] == 2);
+	CHECK(cA[1][1] == 3 and cB[1][1] == 0);
+
+	// The only other copy released: the rows may still be shared with B
+	{
+		SharedRows<int> C {A};
+	}
+	A[2][2] = 4;
+	CHECK(cB[2][2] == 0);
+	B[3][0] = 5;
+	CHECK(cA[3][0] == 0);
+
+	SharedRows<int> D {move(B)};
+	const SharedRows<int> &cD {D};
+	D[1][1] = 6;
+	CHECK(cA[1][1] == 3);
+	A[0][1] = 7;
+	CHECK(cD[0][1] == 0);
+
+	SharedRows<int> E;
+	const SharedRows<int> &cE {E};
+	E = A;
+	A[0][2] = 8;
+	E[2][0] = 9;
+	CHECK(cE[0][2] == 0 and cA[2][0] == 0);
+	CHECK(cE[0][0] == 1 and cE[2][2] == 4);
+
+	// A snapshot read on another thread while the original is written and copied
+	const int n {64};
+	SharedRows<int> W;
+	W.assign(n, Row(n, 0));
+	const SharedRows<int> snapshot {W};
+	atomic<bool> done {false};
+	atomic<int> changed {0};
+	thread reader([&]()
+	{
+		while(not done)
+			FOR(r,0,n) FOR(c,0,n) if(snapshot[r][c] != 0)
+				changed++;
+	});
+	FOR(k,0,20000)
+	{
+		W[k % n][k % (n - 3)] = k + 1;
+		if(k % 100 == 0)
+			SharedRows<int> copy {W};
+	}
+	done = true;
+	reader.join();
+	CHECK(changed == 0);
+}
+
+// An evaluator of another mesh of the same size and edit count never lends it its anchors
+static void testAnchorsNotReusedAcrossMeshes()
+{
+	const int n {10};
+	TMesh A(n, n, 3, 3), B(n, n, 3, 3);
+	A.beginEdit();
+	A.setEdge(false, n - 2, n - 1, false);
+	A.commitEdit();
+	B.beginEdit();
+	B.setEdge(false, n - 2, 0, false);
+	B.commitEdit();
+	CHECK(A.isAS and B.isAS);
+
+	const TMeshEvaluator EA(A);
+	const TMeshEvaluator EB(B), reused(B, &EA);
+	CHECK(reused.numElements() == EB.numElements());
+	const double s0 {B.knotsV[2]}, s1 {B.knotsV[n]}, t0 {B.knotsH[2]}, t1 {B.knotsH[n]};
+	const int m {15};
+	FOR(i,0,m) FOR(j,0,m)
+	{
+		const double s {s0 + (s1 - s0) * i / (m - 1)}, t {t0 + (t1 - t0) * j / (m - 1)};
+		Pt3 P, Q;
+		CHECK(EB.evaluate(s, t, P) and reused.evaluate(s, t, Q) and mag(P - Q) == 0);
+	}
+}
+
+int main()
+{
+	testArcLengthSpacing();
+	testRepeatedKnotStitching();
+	testEditKeepsRowsShared();
+	testMeshOrdering();
+	testSharedTessellationCache();
+	testConcurrentEvaluation();
+	testRebuildOrdering();
+	testSharedRowsCopies();
+	testAnchorsNotReusedAcrossMeshes();
+
+	printf("%s\n", failures == 0 ? "All checks passed" : "Some checks failed");
+	return failures;
+}